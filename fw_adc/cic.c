@@ -0,0 +1,100 @@
+
+/*
+ * Cascaded integrator comb decimator
+ */
+
+#include <math.h>
+
+#include "cic.h"
+
+
+uint8_t cic_init(cic_t* cic,
+                 uint8_t order,
+                 uint8_t ratio_bits,
+                 uint8_t bits,
+                 uint8_t compensate)
+{
+    uint8_t growth = order * ratio_bits;
+    if (order < 1 || order > CIC_MAX_ORDER ||
+        12 + growth > 32 || bits > growth || 12 + bits > 16) {
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < CIC_MAX_ORDER; i++) {
+        cic->integ[i] = 0;
+        cic->comb[i] = 0;
+    }
+
+    cic->order = order;
+    cic->ratio_bits = ratio_bits;
+    cic->shift = growth - bits;
+    cic->phase = 0;
+    cic->max = (1 << (12 + bits)) - 1;
+
+    /*
+     * The response is about sinc(f)^order at the output rate,
+     * the FIR 1 + 2a (1 - cos(2 pi f)). They cancel at a quarter
+     * of the output rate.
+     */
+    double droop = pow(sin(M_PI / 4) / (M_PI / 4), order);
+    cic->compensate = compensate;
+    cic->comp_a = round((1 / droop - 1) / 2 * (1 << 15));
+    cic->comp_x1 = 0;
+    cic->comp_x2 = 0;
+
+    return 1;
+}
+
+
+static inline int32_t cic_compensate(cic_t* cic, int32_t x)
+{
+    // Symmetric, the center is the previous sample
+    int32_t y = (((1 << 15) + 2 * cic->comp_a) * cic->comp_x1 -
+                 cic->comp_a * (x + cic->comp_x2)) >> 15;
+    cic->comp_x2 = cic->comp_x1;
+    cic->comp_x1 = x;
+
+    if (y < 0) {
+        y = 0;
+    }
+    else if (y > cic->max) {
+        y = cic->max;
+    }
+    return y;
+}
+
+
+size_t cic_decimate(cic_t* cic, uint16_t* out,
+                    const uint16_t* samples, size_t len)
+{
+    size_t n = 0;
+    uint32_t mask = (1u << cic->ratio_bits) - 1;
+
+    for (size_t k = 0; k < len; k++) {
+        // Integrators
+        uint32_t v = samples[k];
+        for (uint8_t i = 0; i < cic->order; i++) {
+            cic->integ[i] += v;
+            v = cic->integ[i];
+        }
+
+        if ((++cic->phase & mask) != 0) {
+            continue;
+        }
+
+        // Combs
+        for (uint8_t i = 0; i < cic->order; i++) {
+            uint32_t prev = cic->comb[i];
+            cic->comb[i] = v;
+            v -= prev;
+        }
+
+        int32_t y = v >> cic->shift;
+        if (cic->compensate) {
+            y = cic_compensate(cic, y);
+        }
+        out[n++] = y;
+    }
+
+    return n;
+}
@@ -0,0 +1,58 @@
+#ifndef _CIC_H_
+#define _CIC_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * CIC decimator: order integrators at the input rate,
+ * decimation by 2^ratio_bits and order combs at the
+ * output rate, without any multiplication.
+ *
+ * The registers are 32 bit and wrap around, which is fine
+ * as long as the output fits: 12 + order * ratio_bits
+ * must not exceed 32.
+ *
+ * The output is normalized to 12 + bits bits. The sinc^order
+ * passband droop can be corrected with a 3 tap FIR at the
+ * output rate.
+ */
+
+#define CIC_MAX_ORDER 5
+
+typedef struct {
+    uint32_t integ[CIC_MAX_ORDER];
+    uint32_t comb[CIC_MAX_ORDER];  // Previous comb inputs
+    uint8_t  order;
+    uint8_t  ratio_bits;
+    uint8_t  shift;
+    uint32_t phase;
+
+    // Compensation FIR [-a, 1 + 2a, -a], Q15
+    uint8_t  compensate;
+    int32_t  comp_a;
+    int32_t  comp_x1;
+    int32_t  comp_x2;
+    int32_t  max;
+} cic_t;
+
+/*
+ * Returns 0 if the order is out of range or the
+ * registers would overflow.
+ */
+uint8_t cic_init(cic_t* cic,
+                 uint8_t order,
+                 uint8_t ratio_bits,
+                 uint8_t bits,
+                 uint8_t compensate);
+
+/*
+ * Decimate len 12 bit samples into out.
+ * The phase is carried from block to block.
+ *
+ * Returns the number of output samples.
+ */
+size_t cic_decimate(cic_t* cic, uint16_t* out,
+                    const uint16_t* samples, size_t len);
+
+#endif
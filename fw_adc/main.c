@@ -16,19 +16,78 @@
 #include "usb_serial.h"
 #include "cr4_fft_1024_stm32.h"
 #include "sqrt.h"
+#include "rfft.h"
+#include "dc_filter.h"
+#include "cic.h"
 
 #define MIC_RCC  RCC_GPIOA
 #define MIC_PORT GPIOA
 #define MIC_PIN  GPIO0
 
-#define SAMPLE_BUF_LEN 1024
-volatile uint16_t _adc_samples[SAMPLE_BUF_LEN];
-volatile uint32_t _fft_data[SAMPLE_BUF_LEN];
-volatile uint32_t _fft_result[SAMPLE_BUF_LEN];
+/*
+ * DMA transfers a pair of samples from ADC1 and ADC2 at a
+ * time, which lands as one complex value in the FFT input:
+ * The samples are already in the packed layout for the
+ * real valued FFT.
+ */
+#define SAMPLE_BUF_LEN (2 * RFFT_LEN)
+volatile uint32_t _fft_data[RFFT_LEN];
+volatile uint32_t _fft_result[RFFT_LEN];
 
 #define C_REAL(X) (X & 0xffff)
 #define C_IMAG(X) (X >> 16)
 
+/*
+ * Streaming: The ADCs convert continuously into a circular
+ * DMA double buffer (~1.7 MS/s interleaved). Each half is
+ * decimated with a CIC filter of order ADC_CIC_ORDER by
+ * 2^ADC_CIC_RATIO_BITS, the output has ADC_CIC_BITS extra
+ * bits. Frames of decimated samples are processed in the
+ * main loop while sampling goes on.
+ *
+ * Without, single frames of raw samples are captured.
+ */
+#define ADC_CIC 0
+// #define ADC_CIC 1
+
+#define ADC_CIC_ORDER      4
+#define ADC_CIC_RATIO_BITS 5  // 32: ~53.6 kS/s
+#define ADC_CIC_BITS       2
+#define ADC_CIC_COMPENSATE 1
+
+#if ADC_CIC
+#define ADC_SAMPLE_BITS (12 + ADC_CIC_BITS)
+#else
+#define ADC_SAMPLE_BITS 12
+#endif
+#define ADC_SAMPLE_MID  (1 << (ADC_SAMPLE_BITS - 1))
+
+// Sample pairs per half of the DMA buffer
+#define ADC_DMA_BLOCK_LEN 256
+
+#if ADC_CIC && (1 << ADC_CIC_RATIO_BITS) > 2 * ADC_DMA_BLOCK_LEN
+#error "A DMA block must yield at least one decimated sample"
+#endif
+
+#if ADC_CIC
+uint32_t _adc_dma_buf[2 * ADC_DMA_BLOCK_LEN];
+
+// Decimated samples, copied to the FFT input when complete
+uint32_t _cic_frame[RFFT_LEN];
+size_t   _cic_frame_len;
+cic_t    _cic;
+
+volatile uint8_t _frame_ready;
+uint32_t _frame_count;
+volatile uint32_t _frame_dropped;
+volatile uint32_t _dma_overruns;
+#endif
+
+// DC offset tracking time constant: 2^12 samples
+#define ADC_DC_SHIFT 12
+
+dc_filter_t _dc_filter;
+
 
 void fft_magnitude(uint32_t *values, size_t len)
 {
@@ -41,6 +100,20 @@ void fft_magnitude(uint32_t *values, size_t len)
 }
 
 
+/*
+ * Remove the DC offset from both samples of the
+ * packed pairs, in sample order.
+ */
+void adc_dc_remove(volatile uint32_t* values, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        int32_t a = dc_filter_step(&_dc_filter, C_REAL(values[i]));
+        int32_t b = dc_filter_step(&_dc_filter, C_IMAG(values[i]));
+        values[i] = ((uint32_t)(uint16_t)b << 16) | (uint16_t)a;
+    }
+}
+
+
 void adc_gpio_init()
 {
     // Enable GPIOA
@@ -124,7 +197,11 @@ void dma_init()
     dma_disable_channel(DMA1, DMA_CHANNEL1);
 
     // Set source and dst address
-    dma_set_memory_address(DMA1, DMA_CHANNEL1,     (uint32_t)&_adc_samples);
+#if ADC_CIC
+    dma_set_memory_address(DMA1, DMA_CHANNEL1,     (uint32_t)&_adc_dma_buf);
+#else
+    dma_set_memory_address(DMA1, DMA_CHANNEL1,     (uint32_t)&_fft_data);
+#endif
     dma_set_peripheral_address(DMA1, DMA_CHANNEL1, (uint32_t)&ADC1_DR);
 
     // Setup DMA2 controller:
@@ -136,8 +213,15 @@ void dma_init()
     // We read into mem
     dma_set_read_from_peripheral(DMA1, DMA_CHANNEL1);
 
+#if ADC_CIC
+    // Both halves of the buffer, over and over again
+    dma_set_number_of_data(DMA1, DMA_CHANNEL1, 2 * ADC_DMA_BLOCK_LEN);
+    dma_enable_circular_mode(DMA1, DMA_CHANNEL1);
+    dma_enable_half_transfer_interrupt(DMA1, DMA_CHANNEL1);
+#else
     // As we read from ADC1 and 2, we need half of the samples
     dma_set_number_of_data(DMA1, DMA_CHANNEL1, SAMPLE_BUF_LEN/2);
+#endif
 
     // Increment addr
     dma_enable_memory_increment_mode(DMA1, DMA_CHANNEL1);
@@ -148,45 +232,102 @@ void dma_init()
 }
 
 
-void dma1_channel1_isr()
+/*
+ * Process a full frame: Remove the offset, calculate
+ * the spectrum and print the samples.
+ */
+void frame_process()
 {
-    // Check Transfer complete interrupt flag
-    if (dma_get_interrupt_flag(DMA1, DMA_CHANNEL1, DMA_TCIF)) {
-        dma_disable_channel(DMA1, DMA_CHANNEL1);
+    // Remove dc offset
+    adc_dc_remove(_fft_data, RFFT_LEN);
 
-        // Process signal
-        for(uint16_t i = 0; i < SAMPLE_BUF_LEN; i++) {
-            // TODO: Use DMA for this?
-            _fft_data[i] = _adc_samples[i] - 2048; // remove dc offset
-        }
+    // FFT
+    cr4_fft_1024_stm32((void*)_fft_result, (void*)_fft_data, RFFT_LEN);
+    rfft_split((uint32_t*)_fft_result);
 
-        // FFT
-        cr4_fft_1024_stm32((void*)_fft_result, (void*)_fft_data, 1024);
+    /*
+    uint16_t max = 0;
+    uint32_t avg = 0;
 
-        /*
-        uint16_t max = 0;
-        uint32_t avg = 0;
-
-        for(uint16_t i = 0; i < SAMPLE_BUF_LEN; i++) {
-            if (max < _adc_samples[i]) {
-                max = _adc_samples[i];
-            }
-            avg += _adc_samples[i];
+    for(uint16_t i = 0; i < RFFT_LEN; i++) {
+        if (max < C_REAL(_fft_data[i])) {
+            max = C_REAL(_fft_data[i]);
         }
-        avg /= SAMPLE_BUF_LEN;
-        */
-        fft_magnitude(_fft_result, 512);
+        avg += C_REAL(_fft_data[i]);
+    }
+    avg /= RFFT_LEN;
+    */
+    fft_magnitude((uint32_t*)_fft_result, RFFT_LEN);
 
-        /*
-        for (int i = 0; i < 512; i++) {
-            printf("%d %d\r\n", i, _fft_result[i]);
-        }
-        */
-        for (int i = 0; i < 1024; i++) {
-            printf("%d %d\r\n", i, _adc_samples[i]);
-        }
+    /*
+    for (int i = 0; i < RFFT_LEN; i++) {
+        printf("%d %d\r\n", i, _fft_result[i]);
+    }
+    */
+    for (int i = 0; i < RFFT_LEN; i++) {
+        printf("%d %d\r\n", 2 * i,     (int16_t)C_REAL(_fft_data[i]));
+        printf("%d %d\r\n", 2 * i + 1, (int16_t)C_IMAG(_fft_data[i]));
+    }
+
+    // printf("%d %d\r\n", max, max - avg);
+}
+
+
+#if ADC_CIC
+/*
+ * Decimate a filled half of the DMA buffer. The pairs
+ * are in sample order as half words.
+ */
+void adc_stream_block(const uint32_t* block)
+{
+    _cic_frame_len += cic_decimate(&_cic,
+                                   (uint16_t*)_cic_frame + _cic_frame_len,
+                                   (const uint16_t*)block,
+                                   2 * ADC_DMA_BLOCK_LEN);
+    if (_cic_frame_len < SAMPLE_BUF_LEN) {
+        return;
+    }
+    _cic_frame_len = 0;
 
-        // printf("%d %d\r\n", max, max - avg);
+    // The main loop is still busy with the last one
+    if (_frame_ready) {
+        _frame_dropped++;
+        return;
+    }
+
+    memcpy((void*)_fft_data, _cic_frame, sizeof(_cic_frame));
+    _frame_ready = 1;
+}
+
+
+void dma1_channel1_isr()
+{
+    // Both halves are filled: We were too slow
+    if (dma_get_interrupt_flag(DMA1, DMA_CHANNEL1, DMA_HTIF) &&
+        dma_get_interrupt_flag(DMA1, DMA_CHANNEL1, DMA_TCIF)) {
+        _dma_overruns++;
+    }
+
+    if (dma_get_interrupt_flag(DMA1, DMA_CHANNEL1, DMA_HTIF)) {
+        dma_clear_interrupt_flags(DMA1, DMA_CHANNEL1, DMA_HTIF);
+        adc_stream_block(_adc_dma_buf);
+    }
+
+    if (dma_get_interrupt_flag(DMA1, DMA_CHANNEL1, DMA_TCIF)) {
+        dma_clear_interrupt_flags(DMA1, DMA_CHANNEL1, DMA_TCIF);
+        adc_stream_block(_adc_dma_buf + ADC_DMA_BLOCK_LEN);
+    }
+}
+
+#else
+
+void dma1_channel1_isr()
+{
+    // Check Transfer complete interrupt flag
+    if (dma_get_interrupt_flag(DMA1, DMA_CHANNEL1, DMA_TCIF)) {
+        dma_disable_channel(DMA1, DMA_CHANNEL1);
+
+        frame_process();
 
         // Clear transfer complete.
         dma_clear_interrupt_flags(DMA1, DMA_CHANNEL1, DMA_TCIF);
@@ -196,6 +337,7 @@ void dma1_channel1_isr()
         dma_enable_channel(DMA1, DMA_CHANNEL1);
     }
 }
+#endif
 
 
 
@@ -216,6 +358,16 @@ int main(void)
     // Initialize ADC
     adc_init();
 
+    // Start tracking the offset from the midpoint
+    dc_filter_init(&_dc_filter, ADC_DC_SHIFT, ADC_SAMPLE_MID);
+
+#if ADC_CIC
+    if (!cic_init(&_cic, ADC_CIC_ORDER, ADC_CIC_RATIO_BITS,
+                  ADC_CIC_BITS, ADC_CIC_COMPENSATE)) {
+        printf("CIC setup not supported\r\n");
+    }
+#endif
+
     // Start fetching data
     printf("Starting ADC read\r\n");
     dma_enable_channel(DMA1, DMA_CHANNEL1);
@@ -228,6 +380,16 @@ int main(void)
         }
         */
 
+#if ADC_CIC
+        // Sampling goes on meanwhile
+        if (_frame_ready) {
+            printf("# frame %lu dropped %lu overruns %lu\r\n",
+                   _frame_count++, _frame_dropped, _dma_overruns);
+            frame_process();
+            _frame_ready = 0;
+        }
+#endif
+
         i++;
     }
 }
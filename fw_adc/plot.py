@@ -4,6 +4,8 @@ import serial
 s = serial.Serial("/dev/ttyACM0")
 
 for line in s:
+    if line.startswith(b"#"):
+        continue
     tokens = str(line, "utf8").strip().split(" ")
     val = int(tokens[1])
     print((val) * "#")
@@ -0,0 +1,49 @@
+
+/*
+ * Split stage for a 2N point real FFT computed with
+ * a N point complex FFT.
+ *
+ * With Z = FFT(z) and W = exp(-j pi k / N):
+ *
+ *   E[k] = (Z[k] + Z*[N-k]) / 2
+ *   O[k] = -j (Z[k] - Z*[N-k]) / 2
+ *
+ *   X[k]   = E[k] + W^k O[k]
+ *   X[N-k] = (E[k] - W^k O[k])*
+ */
+
+#include "rfft.h"
+
+#define C_REAL(X) ((int16_t)((X) & 0xffff))
+#define C_IMAG(X) ((int16_t)((X) >> 16))
+#define C_PACK(RE, IM) (((uint32_t)(uint16_t)(IM) << 16) | (uint16_t)(RE))
+
+
+void rfft_split(uint32_t* values)
+{
+    // DC and nyquist are real, the nyquist bin is dropped
+    int32_t re = C_REAL(values[0]);
+    int32_t im = C_IMAG(values[0]);
+    values[0] = C_PACK((re + im) >> 1, 0);
+
+    for (int k = 1; k <= RFFT_LEN / 2; k++) {
+        uint32_t a = values[k];
+        uint32_t b = values[RFFT_LEN - k];
+
+        // Doubled E and O
+        int32_t e_re = C_REAL(a) + C_REAL(b);
+        int32_t e_im = C_IMAG(a) - C_IMAG(b);
+        int32_t o_re = C_IMAG(a) + C_IMAG(b);
+        int32_t o_im = C_REAL(b) - C_REAL(a);
+
+        // W^k O with W = cos - j sin
+        int32_t c = rfft_cos[k];
+        int32_t s = rfft_sin[k];
+        int32_t wo_re = (o_re * c + o_im * s) >> 15;
+        int32_t wo_im = (o_im * c - o_re * s) >> 15;
+
+        values[k] = C_PACK((e_re + wo_re) >> 2, (e_im + wo_im) >> 2);
+        values[RFFT_LEN - k] = C_PACK((e_re - wo_re) >> 2,
+                                      -(e_im - wo_im) >> 2);
+    }
+}
@@ -0,0 +1,70 @@
+
+/*
+ * Moving average and peak hold of spectra
+ */
+
+#include <string.h>
+
+#include "accum.h"
+
+static uint32_t* _accum_avg;
+static uint32_t* _accum_peak;
+static size_t    _accum_len;
+static uint8_t   _accum_avg_shift;
+static uint8_t   _accum_decay_shift;
+static uint8_t   _accum_empty;
+
+
+void accum_init(uint32_t* avg,
+                uint32_t* peak,
+                size_t len,
+                uint8_t avg_shift,
+                uint8_t decay_shift)
+{
+    _accum_avg = avg;
+    _accum_peak = peak;
+    _accum_len = len;
+    _accum_avg_shift = avg_shift;
+    _accum_decay_shift = decay_shift;
+
+    accum_reset();
+}
+
+
+void accum_reset()
+{
+    memset(_accum_peak, 0, _accum_len * sizeof(uint32_t));
+    _accum_empty = 1;
+}
+
+
+void accum_update(uint32_t* values, size_t len, uint8_t view)
+{
+    if (len > _accum_len) {
+        len = _accum_len;
+    }
+
+    // Start the average at the first frame instead of 0
+    if (_accum_empty) {
+        memcpy(_accum_avg, values, len * sizeof(uint32_t));
+        _accum_empty = 0;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        uint32_t v = values[i];
+
+        int64_t d = (int64_t)v - _accum_avg[i];
+        _accum_avg[i] += d >> _accum_avg_shift;
+
+        uint32_t p = _accum_peak[i];
+        p -= p >> _accum_decay_shift;
+        _accum_peak[i] = v > p ? v : p;
+
+        if (view == ACCUM_AVERAGE) {
+            values[i] = _accum_avg[i];
+        }
+        else if (view == ACCUM_PEAK) {
+            values[i] = _accum_peak[i];
+        }
+    }
+}
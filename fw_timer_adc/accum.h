@@ -0,0 +1,35 @@
+#ifndef _ACCUM_H_
+#define _ACCUM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Spectrum accumulators, updated with every frame:
+ *  - AVERAGE: Exponential moving average, each frame
+ *    weighs 1 / (1 << avg_shift)
+ *  - PEAK: Peak hold, decaying by 1 / (1 << decay_shift)
+ *    per frame
+ *
+ * Buffers for len values each are provided by the caller.
+ */
+
+#define ACCUM_INSTANT 0
+#define ACCUM_AVERAGE 1
+#define ACCUM_PEAK    2
+
+void accum_init(uint32_t* avg,
+                uint32_t* peak,
+                size_t len,
+                uint8_t avg_shift,
+                uint8_t decay_shift);
+
+void accum_reset();
+
+/*
+ * Update the accumulators with a new frame and replace
+ * values with the selected view.
+ */
+void accum_update(uint32_t* values, size_t len, uint8_t view);
+
+#endif
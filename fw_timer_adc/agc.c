@@ -0,0 +1,58 @@
+
+/*
+ * Automatic gain control
+ */
+
+#include "agc.h"
+
+static int32_t _agc_target;
+static uint8_t _agc_attack;
+static uint8_t _agc_release;
+static int32_t _agc_min_gain;
+static int32_t _agc_max_gain;
+
+static int32_t _agc_gain;
+
+
+void agc_init(int32_t target,
+              uint8_t attack,
+              uint8_t release,
+              int32_t min_gain,
+              int32_t max_gain)
+{
+    _agc_target = target;
+    _agc_attack = attack;
+    _agc_release = release;
+    _agc_min_gain = min_gain;
+    _agc_max_gain = max_gain;
+
+    _agc_gain = min_gain;
+}
+
+
+void agc_update(uint32_t peak, uint8_t shift)
+{
+    // Gain mapping the peak to the target level
+    int32_t gain = _agc_max_gain;
+    if (peak > 0) {
+        int64_t g = ((int64_t)_agc_target << shift) / peak;
+        if (g < gain) {
+            gain = g;
+        }
+    }
+    if (gain < _agc_min_gain) {
+        gain = _agc_min_gain;
+    }
+
+    if (gain < _agc_gain) {
+        _agc_gain += (gain - _agc_gain) >> _agc_attack;
+    } else {
+        _agc_gain += (gain - _agc_gain) >> _agc_release;
+    }
+}
+
+
+int32_t agc_gain()
+{
+    return _agc_gain;
+}
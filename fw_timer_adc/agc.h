@@ -0,0 +1,30 @@
+#ifndef _AGC_H_
+#define _AGC_H_
+
+#include <stdint.h>
+
+/*
+ * Automatic gain control: The gain is adjusted between
+ * frames, so the frame peak ends up at the target level.
+ *
+ * Gains are Q15. Attack and release are shifts, a new gain
+ * is approached by 1/2^attack per frame when the signal gets
+ * louder and by 1/2^release when it gets quieter.
+ */
+
+void agc_init(int32_t target,
+              uint8_t attack,
+              uint8_t release,
+              int32_t min_gain,
+              int32_t max_gain);
+
+/*
+ * Update the gain with the peak of the last frame. The
+ * peak is measured before the gain is applied with the
+ * right shift of shift.
+ */
+void agc_update(uint32_t peak, uint8_t shift);
+
+int32_t agc_gain();
+
+#endif
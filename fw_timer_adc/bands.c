@@ -0,0 +1,62 @@
+
+/*
+ * Band aggregation of power spectra
+ */
+
+#include "bands.h"
+
+static uint16_t _bands_lo[BANDS_MAX];
+static uint16_t _bands_hi[BANDS_MAX];
+static size_t   _bands_count;
+
+
+static size_t bands_bin(uint32_t freq, uint32_t sample_rate, size_t bins)
+{
+    // Rounded to the nearest bin edge
+    return (2 * freq * bins + sample_rate / 2) / sample_rate;
+}
+
+
+void bands_init(uint8_t scale, uint32_t sample_rate, size_t bins)
+{
+    const uint16_t* edges = band_edges[scale];
+
+    _bands_count = 0;
+    size_t lo = bands_bin(edges[0], sample_rate, bins);
+    for (size_t i = 0; i < band_counts[scale]; i++) {
+        size_t hi = bands_bin(edges[i + 1], sample_rate, bins);
+
+        if (lo >= bins) {
+            break;
+        }
+        if (hi > bins) {
+            hi = bins;
+        }
+
+        // Narrower than a bin, joined with the next band
+        if (hi <= lo) {
+            continue;
+        }
+
+        _bands_lo[_bands_count] = lo;
+        _bands_hi[_bands_count] = hi;
+        _bands_count++;
+        lo = hi;
+    }
+}
+
+
+size_t bands_apply(const uint32_t* power, uint32_t* out)
+{
+    // With the FFT scaled by 1/N the total power of a
+    // 16 bit signal stays below 2^30, sums can not overflow.
+    for (size_t b = 0; b < _bands_count; b++) {
+        uint32_t sum = 0;
+        for (size_t i = _bands_lo[b]; i < _bands_hi[b]; i++) {
+            sum += power[i];
+        }
+        out[b] = sum;
+    }
+
+    return _bands_count;
+}
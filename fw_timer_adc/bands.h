@@ -0,0 +1,42 @@
+#ifndef _BANDS_H_
+#define _BANDS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Band aggregation: Sum the power of the FFT bins in
+ * each band, so only the band energies are sent.
+ *
+ * Band edges are generated at build time by gen_bands.py
+ * for SAMPLE_RATE in the Makefile, up to its nyquist
+ * frequency, and mapped to bins for the FFT length.
+ * Bands narrower than a bin are joined with the next one,
+ * so every bin is counted once and short FFTs get fewer
+ * bands.
+ */
+
+#define BANDS_LINEAR       0
+#define BANDS_MEL          1
+#define BANDS_THIRD_OCTAVE 2
+
+#define BANDS_SCALES 3
+
+#define BANDS_MAX 32
+
+extern const uint16_t* const band_edges[BANDS_SCALES];
+extern const uint8_t band_counts[BANDS_SCALES];
+
+/*
+ * Map a scale to bins 0 .. bins - 1, which cover
+ * 0 .. sample_rate / 2.
+ */
+void bands_init(uint8_t scale, uint32_t sample_rate, size_t bins);
+
+/*
+ * Sum the power bins into out.
+ * Returns the number of bands.
+ */
+size_t bands_apply(const uint32_t* power, uint32_t* out);
+
+#endif
@@ -0,0 +1,88 @@
+
+/*
+ * Host test for bands: Every bin of the spectrum has to
+ * end up in exactly one band, in order, for all scales
+ * and frame lengths down to the 64 point FFT. Only bins
+ * below the lowest edge may be left out.
+ *
+ * Usage: make host_test
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "bands.h"
+
+// Sample rate the band tables are generated for
+#define BANDS_TEST_RATE 40000
+
+static const char* const _scale_names[BANDS_SCALES] = {
+    "linear", "mel", "third octave",
+};
+
+static uint32_t _power[1024];
+static uint32_t _out[BANDS_MAX];
+
+
+/*
+ * Feed one bin at a time, returns the number of bins not
+ * found in exactly one band or out of band order.
+ */
+static int bands_test_edges(size_t bins, size_t* count)
+{
+    int errors = 0;
+    int started = 0;
+    size_t last = 0;
+
+    for (size_t k = 0; k < bins; k++) {
+        for (size_t i = 0; i < bins; i++) {
+            _power[i] = i == k;
+        }
+
+        *count = bands_apply(_power, _out);
+
+        size_t found = 0;
+        size_t band = 0;
+        for (size_t b = 0; b < *count; b++) {
+            if (_out[b]) {
+                found++;
+                band = b;
+            }
+        }
+
+        if (found == 0 && !started) {
+            continue;
+        }
+        if (found != 1 || band < last || band > last + started) {
+            errors++;
+        }
+        started = 1;
+        last = band;
+    }
+
+    if (last + 1 != *count) {
+        errors++;
+    }
+    return errors;
+}
+
+
+int main()
+{
+    int failed = 0;
+
+    for (uint8_t scale = 0; scale < BANDS_SCALES; scale++) {
+        for (size_t bins = 32; bins <= 1024; bins *= 2) {
+            bands_init(scale, BANDS_TEST_RATE, bins);
+
+            size_t count;
+            int errors = bands_test_edges(bins, &count);
+            printf("bands %-12s %4zu bins: %2zu bands, %d errors %s\n",
+                   _scale_names[scale], bins, count, errors,
+                   errors ? "FAIL" : "ok");
+            failed |= errors != 0;
+        }
+    }
+
+    return failed;
+}
@@ -0,0 +1,87 @@
+
+/*
+ * Fixed point biquad cascade
+ */
+
+#include <math.h>
+
+#include "biquad.h"
+
+
+void biquad_init(biquad_t* filter)
+{
+    filter->count = 0;
+}
+
+
+void biquad_reset(biquad_t* filter)
+{
+    for (uint8_t i = 0; i < filter->count; i++) {
+        biquad_section_t* s = &filter->sections[i];
+        s->x1 = 0;
+        s->x2 = 0;
+        s->y1 = 0;
+        s->y2 = 0;
+        s->err = 0;
+    }
+}
+
+
+uint8_t biquad_set(biquad_t* filter, size_t i,
+                   int32_t b0, int32_t b1, int32_t b2,
+                   int32_t a1, int32_t a2)
+{
+    if (i >= BIQUAD_MAX_SECTIONS) {
+        return 0;
+    }
+
+    // New sections pass samples until set
+    while (filter->count <= i) {
+        biquad_section_t* s = &filter->sections[filter->count++];
+        s->b0 = 1 << BIQUAD_COEFF_FRAC;
+        s->b1 = 0;
+        s->b2 = 0;
+        s->a1 = 0;
+        s->a2 = 0;
+    }
+
+    biquad_section_t* s = &filter->sections[i];
+    s->b0 = b0;
+    s->b1 = b1;
+    s->b2 = b2;
+    s->a1 = a1;
+    s->a2 = a2;
+
+    // The old state does not match the new response
+    biquad_reset(filter);
+
+    return 1;
+}
+
+
+/*
+ * Notch from the audio EQ cookbook:
+ *
+ *   b = (1, -2 cos w, 1) / a0,  a = (-2 cos w, 1 - alpha) / a0
+ *
+ * with alpha = sin w / (2 q) and a0 = 1 + alpha.
+ */
+uint8_t biquad_set_notch(biquad_t* filter, size_t i,
+                         uint32_t freq, uint32_t rate, float q)
+{
+    double w = 2 * M_PI * freq / rate;
+    double alpha = sin(w) / (2 * q);
+    double scale = (1 << BIQUAD_COEFF_FRAC) / (1 + alpha);
+
+    int32_t b0 = round(scale);
+    int32_t b1 = round(-2 * cos(w) * scale);
+
+    return biquad_set(filter, i, b0, b1, b0,
+                      b1, round((1 - alpha) * scale));
+}
+
+
+void biquad_clear(biquad_t* filter)
+{
+    filter->count = 0;
+}
@@ -0,0 +1,95 @@
+#ifndef _BIQUAD_H_
+#define _BIQUAD_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Biquad cascade: Up to BIQUAD_MAX_SECTIONS second order
+ * IIR sections in direct form I
+ *
+ *   y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2]
+ *                  - a1 y[n-1] - a2 y[n-2]
+ *
+ * Coefficients are Q30 (-2 .. 2), samples carry BIQUAD_FRAC
+ * fractional bits through the cascade, the sums are 64 bit.
+ * The state is kept until biquad_reset.
+ *
+ * Poles close to the unit circle at low frequencies, e.g.
+ * of a mains notch, amplify the rounding error of y a lot.
+ * The remainder is fed back into the next sum, which
+ * shapes the error with a zero at DC.
+ */
+
+#define BIQUAD_MAX_SECTIONS 4
+
+#define BIQUAD_COEFF_FRAC 30
+#define BIQUAD_FRAC       8
+
+typedef struct {
+    int32_t b0, b1, b2;
+    int32_t a1, a2;
+
+    int32_t x1, x2;
+    int32_t y1, y2;
+    int32_t err;  // Rounding remainder, Q30
+} biquad_section_t;
+
+typedef struct {
+    biquad_section_t sections[BIQUAD_MAX_SECTIONS];
+    uint8_t count;
+} biquad_t;
+
+// Start with an empty cascade, passing samples unchanged
+void biquad_init(biquad_t* filter);
+
+// Clear the state of all sections
+void biquad_reset(biquad_t* filter);
+
+/*
+ * Set section i to the given Q30 coefficients, with a1 and
+ * a2 as in the difference equation above. The cascade is
+ * extended up to i. Returns 0 if i is out of range.
+ */
+uint8_t biquad_set(biquad_t* filter, size_t i,
+                   int32_t b0, int32_t b1, int32_t b2,
+                   int32_t a1, int32_t a2);
+
+// Set section i to a notch at freq Hz with quality q
+uint8_t biquad_set_notch(biquad_t* filter, size_t i,
+                         uint32_t freq, uint32_t rate, float q);
+
+// Remove all sections
+void biquad_clear(biquad_t* filter);
+
+
+static inline int32_t biquad_section_step(biquad_section_t* s, int32_t x)
+{
+    int64_t acc = (int64_t)s->b0 * x + (int64_t)s->b1 * s->x1 +
+                  (int64_t)s->b2 * s->x2 - (int64_t)s->a1 * s->y1 -
+                  (int64_t)s->a2 * s->y2 + s->err;
+    int32_t y = acc >> BIQUAD_COEFF_FRAC;
+
+    s->err = acc & ((1 << BIQUAD_COEFF_FRAC) - 1);
+    s->x2 = s->x1;
+    s->x1 = x;
+    s->y2 = s->y1;
+    s->y1 = y;
+
+    return y;
+}
+
+/*
+ * Filter one sample. The result has BIQUAD_FRAC
+ * fractional bits, also without sections.
+ */
+static inline int32_t biquad_step(biquad_t* filter, int32_t x)
+{
+    int32_t y = x << BIQUAD_FRAC;
+    for (uint8_t i = 0; i < filter->count; i++) {
+        y = biquad_section_step(&filter->sections[i], y);
+    }
+    return y;
+}
+
+#endif
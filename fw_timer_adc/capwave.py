@@ -17,7 +17,11 @@ def receive(port, filename):
     t0 = time.time()
     i = 0
     for line in s:
-        t = str(line, "utf8").strip().split(" ")
+        line = str(line, "utf8").strip()
+        if line.startswith("#"):
+            continue # Frame info
+
+        t = line.split(" ")
         v = int(t[1])
         buf[i] = v
 
@@ -0,0 +1,83 @@
+
+/*
+ * Fused signal conditioning kernel
+ */
+
+#include "condition.h"
+
+
+static inline int16_t condition_sample(int16_t sample,
+                                       int16_t weight,
+                                       int32_t gain,
+                                       uint8_t shift,
+                                       uint32_t* peak)
+{
+    int32_t v = sample;
+    uint32_t a = v < 0 ? -v : v;
+    if (a > *peak) {
+        *peak = a;
+    }
+
+    // gain
+    v = ((int64_t)v * gain) >> shift;
+
+    // clipping
+    if (v > INT16_MAX) {
+        v = INT16_MAX;
+    }
+    else if (v < INT16_MIN) {
+        v = INT16_MIN;
+    }
+
+    // window, Q15
+    return (v * weight) >> 15;
+}
+
+
+uint32_t condition_apply(uint32_t* values,
+                         const int16_t* window,
+                         size_t step,
+                         size_t len,
+                         int32_t gain,
+                         uint8_t shift)
+{
+    uint32_t peak = 0;
+
+    // real part, imaginary is 0
+    for (size_t i = 0; i < len / 2; i++) {
+        int16_t v = condition_sample((int16_t)values[i], window[i * step],
+                                     gain, shift, &peak);
+        values[i] = (uint16_t)v;
+    }
+    for (size_t i = len / 2; i < len; i++) {
+        int16_t v = condition_sample((int16_t)values[i], window[(len - i) * step],
+                                     gain, shift, &peak);
+        values[i] = (uint16_t)v;
+    }
+
+    return peak;
+}
+
+
+uint32_t condition_apply_packed(uint32_t* values,
+                                const int16_t* window,
+                                size_t step,
+                                size_t len,
+                                int32_t gain,
+                                uint8_t shift)
+{
+    uint32_t peak = 0;
+    int16_t* samples = (int16_t*)values;
+
+    // First half of the window rising, second falling
+    for (size_t i = 0; i < len; i++) {
+        samples[i] = condition_sample(samples[i], window[i * step],
+                                      gain, shift, &peak);
+    }
+    for (size_t i = len; i < 2 * len; i++) {
+        samples[i] = condition_sample(samples[i], window[(2 * len - i) * step],
+                                      gain, shift, &peak);
+    }
+
+    return peak;
+}
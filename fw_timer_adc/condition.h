@@ -0,0 +1,76 @@
+#ifndef _CONDITION_H_
+#define _CONDITION_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "dc_filter.h"
+#include "biquad.h"
+
+/*
+ * Signal conditioning in two parts:
+ *
+ * condition_filter removes the DC offset and runs the filter
+ * cascade, one sample at a time as the samples arrive. Both
+ * keep their state from sample to sample, so they have to
+ * see the continuous stream. Frames are cut from its output.
+ *
+ * condition_apply applies gain, clips, scales to 16 bit and
+ * applies the window in a single pass over the frame.
+ * BENCH in main.c times it against separate passes.
+ */
+
+/*
+ * Remove the offset and filter one raw sample. The result
+ * is in ADC steps, rounded.
+ */
+static inline int16_t condition_filter(uint16_t sample,
+                                       dc_filter_t* dc,
+                                       biquad_t* filter)
+{
+    int32_t v = dc_filter_step(dc, sample);
+    v = biquad_step(filter, v);
+    v = (v + (1 << (BIQUAD_FRAC - 1))) >> BIQUAD_FRAC;
+
+    if (v > INT16_MAX) {
+        v = INT16_MAX;
+    }
+    else if (v < INT16_MIN) {
+        v = INT16_MIN;
+    }
+    return v;
+}
+
+/*
+ * The filtered samples are expected in the real part of
+ * the complex FFT input and are replaced in place.
+ *
+ * gain is Q15 and applied with a right shift of shift,
+ * so (1 << 15) >> shift maps one ADC step to 16 bit.
+ *
+ * window is a half window table (see window.h), used
+ * with every step-th weight.
+ *
+ * Returns the peak absolute value of the samples,
+ * before gain.
+ */
+uint32_t condition_apply(uint32_t* values,
+                         const int16_t* window,
+                         size_t step,
+                         size_t len,
+                         int32_t gain,
+                         uint8_t shift);
+
+/*
+ * Same for the packed input of a real FFT: The frame
+ * holds 2 * len samples as half words, two per complex
+ * value, and is conditioned in sample order.
+ */
+uint32_t condition_apply_packed(uint32_t* values,
+                                const int16_t* window,
+                                size_t step,
+                                size_t len,
+                                int32_t gain,
+                                uint8_t shift);
+
+#endif
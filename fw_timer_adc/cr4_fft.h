@@ -20,5 +20,8 @@ void cr4_fft_256_stm32(void *pssOUT, void *pssIN, unsigned short Nbin);
 void cr4_fft_64_stm32(void *pssOUT, void *pssIN, unsigned short Nbin);
 // }
 
+/* Portable C version of the above, any power of 4 up to 1024 points */
+void cr4_fft_ref(void *pssOUT, void *pssIN, unsigned short Nbin);
+
 #endif
 
@@ -20,6 +20,7 @@
 .text	
 
 .global cr4_fft_1024_stm32
+.global TableFFT_V7
 .extern TableFFT
   
 .equ NPT, 1024
@@ -0,0 +1,161 @@
+
+/*
+ * Portable C version of the radix-4 FFT in cr4_fft_*_stm32.s
+ *
+ * Follows the assembly step by step: Digit reversed first
+ * pass, Q14 twiddles applied with three multiplications,
+ * the same arithmetic shifts for scaling and truncation
+ * to 16 bit on every store, so the signal chain can be
+ * built and checked on the host.
+ *
+ * "make host_test" compares it with a floating point DFT,
+ * FFT_REF_CHECK in main.c with the assembly on the target.
+ *
+ * The twiddle table is TableFFT_V7 from cr4_fft_1024_stm32.s,
+ * on the host a copy generated by gen_cr4_table.py.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "cr4_fft.h"
+
+#define C_REAL(X) ((int16_t)((X) & 0xffff))
+#define C_IMAG(X) ((int16_t)((X) >> 16))
+#define C_PACK(RE, IM) (((uint32_t)(uint16_t)(IM) << 16) | (uint16_t)(RE))
+
+// Twiddles for the passes combining 4, 16, 64 and 256 points
+#define CR4_TABLE_LEN (3 * (4 + 16 + 64 + 256))
+
+/*
+ * For W = exp(-j theta) each entry holds (cos - sin, sin)
+ * in Q14. The three twiddles of butterfly j in a pass of
+ * quarter length q are W^3j, W^j and W^2j with theta =
+ * 2 pi / 4q.
+ */
+extern const int16_t TableFFT_V7[CR4_TABLE_LEN][2];
+
+
+static size_t cr4_bitrev(size_t i, unsigned bits)
+{
+    size_t r = 0;
+    for (unsigned b = 0; b < bits; b++) {
+        r = (r << 1) | ((i >> b) & 1);
+    }
+    return r;
+}
+
+
+/*
+ * Multiply x with a twiddle: The result is in Q14
+ * and not shifted back yet.
+ */
+static void cr4_twiddle(int32_t* re, int32_t* im,
+                        uint32_t x, const int16_t* w)
+{
+    int32_t x_re = C_REAL(x);
+    int32_t x_im = C_IMAG(x);
+
+    int32_t k = (x_im - x_re) * w[1];
+    *im = x_im * w[0] + k;
+    *re = x_re * (w[0] + 2 * w[1]) + k;
+}
+
+
+void cr4_fft_ref(void *pssOUT, void *pssIN, unsigned short Nbin)
+{
+    uint32_t* out = pssOUT;
+    const uint32_t* in = pssIN;
+
+    size_t n4 = Nbin / 4;
+    unsigned bits = 0;
+    while (((size_t)1 << bits) < n4) {
+        bits++;
+    }
+
+    // First pass, 4 point butterflies on bit reversed input
+    for (size_t i = 0; i < n4; i++) {
+        size_t k = cr4_bitrev(i, bits);
+
+        int32_t r4  = C_REAL(in[k]);
+        int32_t r5  = C_IMAG(in[k]);
+        int32_t r8  = C_REAL(in[k + n4]);
+        int32_t r9  = C_IMAG(in[k + n4]);
+        int32_t r6  = C_REAL(in[k + 2 * n4]);
+        int32_t r7  = C_IMAG(in[k + 2 * n4]);
+        int32_t r10 = C_REAL(in[k + 3 * n4]);
+        int32_t r11 = C_IMAG(in[k + 3 * n4]);
+
+        r8  = r8 + r10;
+        r9  = r9 + r11;
+        r10 = r8 - 2 * r10;
+        r11 = r9 - 2 * r11;
+
+        r4 = r4 >> 2;
+        r5 = r5 >> 2;
+        r4 = r4 + (r6 >> 2);
+        r5 = r5 + (r7 >> 2);
+        r6 = r4 - (r6 >> 1);
+        r7 = r5 - (r7 >> 1);
+
+        r4 = r4 + (r8 >> 2);
+        r5 = r5 + (r9 >> 2);
+        r8 = r4 - (r8 >> 1);
+        r9 = r5 - (r9 >> 1);
+
+        r6  = r6 + (r11 >> 2);
+        r7  = r7 - (r10 >> 2);
+        r11 = r6 - (r11 >> 1);
+        r10 = r7 + (r10 >> 1);
+
+        out[4 * i + 0] = C_PACK(r4, r5);
+        out[4 * i + 1] = C_PACK(r6, r7);
+        out[4 * i + 2] = C_PACK(r8, r9);
+        out[4 * i + 3] = C_PACK(r11, r10);
+    }
+
+    // Remaining passes, in place
+    const int16_t (*w)[2] = TableFFT_V7;
+    for (size_t q = 4; q < Nbin; q *= 4) {
+        for (size_t base = 0; base < Nbin; base += 4 * q) {
+            for (size_t j = 0; j < q; j++) {
+                uint32_t* p = out + base + j;
+                int32_t r4, r5, r6, r7, r8, r9, r10, r11;
+
+                cr4_twiddle(&r10, &r11, p[3 * q], w[3 * j]);
+                cr4_twiddle(&r8,  &r9,  p[2 * q], w[3 * j + 1]);
+                cr4_twiddle(&r6,  &r7,  p[q],     w[3 * j + 2]);
+                r4 = C_REAL(p[0]);
+                r5 = C_IMAG(p[0]);
+
+                r8  = r8 + r10;
+                r9  = r9 + r11;
+                r10 = r8 - 2 * r10;
+                r11 = r9 - 2 * r11;
+
+                r4 = r4 >> 2;
+                r5 = r5 >> 2;
+                r4 = r4 + (r6 >> (2 + 14));
+                r5 = r5 + (r7 >> (2 + 14));
+                r6 = r4 - (r6 >> (1 + 14));
+                r7 = r5 - (r7 >> (1 + 14));
+
+                r4 = r4 + (r8 >> (2 + 14));
+                r5 = r5 + (r9 >> (2 + 14));
+                r8 = r4 - (r8 >> (1 + 14));
+                r9 = r5 - (r9 >> (1 + 14));
+
+                r6  = r6 + (r11 >> (2 + 14));
+                r7  = r7 - (r10 >> (2 + 14));
+                r11 = r6 - (r11 >> (1 + 14));
+                r10 = r7 + (r10 >> (1 + 14));
+
+                p[0]     = C_PACK(r4, r5);
+                p[q]     = C_PACK(r6, r7);
+                p[2 * q] = C_PACK(r8, r9);
+                p[3 * q] = C_PACK(r11, r10);
+            }
+        }
+        w += 3 * q;
+    }
+}
@@ -0,0 +1,106 @@
+
+/*
+ * Host test for cr4_fft_ref: Compare with a floating point
+ * DFT, scaled by 1/N like the assembly.
+ *
+ * Usage: make host_test
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "cr4_fft.h"
+
+// Allowed deviation per component and radix-4 pass in output
+// LSB, every pass truncates its results.
+#define CR4_TEST_PASS_ERROR 2.0
+
+// Minimum ratio of the DFT power to the error power in dB at
+// 64 points. The 1/4 scaling of every further pass costs 6 dB.
+#define CR4_TEST_SNR      54.0
+#define CR4_TEST_PASS_SNR 6.0
+
+#define C_REAL(X) ((int16_t)((X) & 0xffff))
+#define C_IMAG(X) ((int16_t)((X) >> 16))
+#define C_PACK(RE, IM) (((uint32_t)(uint16_t)(IM) << 16) | (uint16_t)(RE))
+
+static uint32_t _in[1024];
+static uint32_t _out[1024];
+
+
+/*
+ * Fill the input with a few tones and noise, close to
+ * full scale.
+ */
+static void cr4_test_signal(size_t n, unsigned seed)
+{
+    srand(seed);
+    for (size_t i = 0; i < n; i++) {
+        double x = 2 * M_PI * i / n;
+        double re = 12000 * cos(3 * x) + 6000 * sin(17 * x + 0.3);
+        double im = 8000 * sin(5 * x) - 4000 * cos(n / 4 * x);
+        re += (rand() % 8001) - 4000;
+        im += (rand() % 8001) - 4000;
+        _in[i] = C_PACK(lround(re), lround(im));
+    }
+}
+
+
+/*
+ * Largest deviation of the output from the DFT, and the
+ * ratio of DFT to error power in dB in snr
+ */
+static double cr4_test_error(size_t n, double* snr)
+{
+    double max_error = 0;
+    double signal = 0;
+    double noise = 0;
+
+    for (size_t k = 0; k < n; k++) {
+        double re = 0;
+        double im = 0;
+        for (size_t i = 0; i < n; i++) {
+            double x = -2 * M_PI * ((i * k) % n) / n;
+            double a = C_REAL(_in[i]);
+            double b = C_IMAG(_in[i]);
+            re += a * cos(x) - b * sin(x);
+            im += a * sin(x) + b * cos(x);
+        }
+
+        double e_re = fabs(C_REAL(_out[k]) - re / n);
+        double e_im = fabs(C_IMAG(_out[k]) - im / n);
+        max_error = fmax(max_error, fmax(e_re, e_im));
+
+        signal += (re * re + im * im) / ((double)n * n);
+        noise += e_re * e_re + e_im * e_im;
+    }
+
+    *snr = 10 * log10(signal / noise);
+    return max_error;
+}
+
+
+int main()
+{
+    int failed = 0;
+
+    for (size_t n = 64, passes = 3; n <= 1024; n *= 4, passes++) {
+        for (unsigned seed = 1; seed <= 4; seed++) {
+            cr4_test_signal(n, seed);
+            cr4_fft_ref(_out, _in, n);
+
+            double snr;
+            double error = cr4_test_error(n, &snr);
+            int ok = error <= passes * CR4_TEST_PASS_ERROR &&
+                     snr >= CR4_TEST_SNR - (passes - 3) * CR4_TEST_PASS_SNR;
+            printf("cr4_fft_ref %4zu points, seed %u: "
+                   "max error %.2f LSB, snr %.1f dB %s\n",
+                   n, seed, error, snr, ok ? "ok" : "FAIL");
+            failed |= !ok;
+        }
+    }
+
+    return failed;
+}
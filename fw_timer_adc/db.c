@@ -0,0 +1,47 @@
+
+/*
+ * Decibel conversion with CLZ and a mantissa table
+ */
+
+#include "db.h"
+
+// log2(1 + i/32) in Q15
+static const uint16_t _db_log2[33] = {
+        0,  1455,  2866,  4236,  5568,  6863,  8124,  9352,
+    10549, 11716, 12855, 13968, 15055, 16117, 17156, 18173,
+    19168, 20143, 21098, 22034, 22952, 23852, 24736, 25604,
+    26455, 27292, 28114, 28922, 29717, 30498, 31267, 32024,
+    32768,
+};
+
+// 10 log10(2) * 256 in Q16
+#define DB_PER_OCTAVE 50504453
+
+
+uint16_t db_from_power(uint32_t p)
+{
+    if (p <= 1) {
+        return 0;
+    }
+
+    uint32_t e = 31 - __builtin_clz(p);
+
+    // Mantissa below the leading one, left aligned
+    uint32_t m = p << (31 - e) << 1;
+    uint32_t i = m >> 27;             // Table index, 5 bit
+    uint32_t f = (m >> 11) & 0xffff;  // Fraction, 16 bit
+
+    uint32_t lo = _db_log2[i];
+    uint32_t hi = _db_log2[i + 1];
+    uint32_t log2 = (e << 15) + lo + (((hi - lo) * f) >> 16);
+
+    return ((uint64_t)log2 * DB_PER_OCTAVE) >> (15 + 16);
+}
+
+
+void db_apply(uint32_t* values, size_t len, uint8_t shift)
+{
+    for (size_t i = 0; i < len; i++) {
+        values[i] = db_from_power(values[i]) >> shift;
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef _DB_H_
+#define _DB_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Fixed point decibels: 10 log10(p) of a power value,
+ * relative to 1 (one LSB squared), in steps of 1/256 dB.
+ * 0 maps to 0 dB, 2^32 - 1 to about 96.3 dB.
+ *
+ * log2 is taken from CLZ for the integer part and a
+ * 32 entry table with linear interpolation for the
+ * mantissa, the error is below 0.01 dB.
+ */
+
+uint16_t db_from_power(uint32_t p);
+
+/*
+ * Convert power bins to dB in place, scaled down
+ * by shift: 7 gives 1/2 dB steps in 8 bit.
+ */
+void db_apply(uint32_t* values, size_t len, uint8_t shift);
+
+#endif
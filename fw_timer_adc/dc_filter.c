@@ -0,0 +1,13 @@
+
+/*
+ * Adaptive DC offset tracking
+ */
+
+#include "dc_filter.h"
+
+
+void dc_filter_init(dc_filter_t* filter, uint8_t shift, int32_t dc)
+{
+    filter->shift = shift;
+    filter->dc = dc << DC_FILTER_FRAC;
+}
@@ -0,0 +1,40 @@
+#ifndef _DC_FILTER_H_
+#define _DC_FILTER_H_
+
+#include <stdint.h>
+
+/*
+ * Adaptive DC offset tracking: A one pole high pass
+ *
+ *   y[n]  = x[n] - dc[n]
+ *   dc[n+1] = dc[n] + y[n] / 2^shift
+ *
+ * The estimate is kept with DC_FILTER_FRAC fractional
+ * bits and carried across frames. The time constant is
+ * 2^shift samples.
+ */
+
+#define DC_FILTER_FRAC 12
+
+typedef struct {
+    int32_t dc;
+    uint8_t shift;
+} dc_filter_t;
+
+void dc_filter_init(dc_filter_t* filter, uint8_t shift, int32_t dc);
+
+static inline int32_t dc_filter_step(dc_filter_t* filter, int32_t x)
+{
+    int32_t y = x - ((filter->dc + (1 << (DC_FILTER_FRAC - 1)))
+                     >> DC_FILTER_FRAC);
+    filter->dc += (y << DC_FILTER_FRAC) >> filter->shift;
+    return y;
+}
+
+// Current offset estimate
+static inline int32_t dc_filter_offset(const dc_filter_t* filter)
+{
+    return filter->dc >> DC_FILTER_FRAC;
+}
+
+#endif
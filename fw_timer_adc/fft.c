@@ -0,0 +1,38 @@
+
+/*
+ * Dispatch to the radix-4 FFT of the requested size.
+ * All sizes share the twiddle table of the 1024 point FFT.
+ *
+ * Host builds use the portable C version instead.
+ */
+
+#include "fft.h"
+#include "cr4_fft.h"
+
+
+uint8_t fft_len_supported(size_t len)
+{
+    return len == 64 || len == 256 || len == 1024;
+}
+
+
+void fft_transform(uint32_t* out, uint32_t* in, size_t len)
+{
+#ifndef __arm__
+    if (fft_len_supported(len)) {
+        cr4_fft_ref(out, in, len);
+    }
+#else
+    switch (len) {
+        case 64:
+            cr4_fft_64_stm32(out, in, len);
+            break;
+        case 256:
+            cr4_fft_256_stm32(out, in, len);
+            break;
+        case 1024:
+            cr4_fft_1024_stm32(out, in, len);
+            break;
+    }
+#endif
+}
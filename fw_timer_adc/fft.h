@@ -0,0 +1,23 @@
+#ifndef _FFT_H_
+#define _FFT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Complex radix-4 FFT of 64, 256 or 1024 points with
+ * the length selected at runtime. See cr4_fft.h for the
+ * data format, the result is scaled by 1/len.
+ */
+
+#define FFT_MAX_LEN 1024
+
+uint8_t fft_len_supported(size_t len);
+
+/*
+ * Transform len points from in to out. Does nothing
+ * if the length is not supported.
+ */
+void fft_transform(uint32_t* out, uint32_t* in, size_t len);
+
+#endif
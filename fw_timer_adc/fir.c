@@ -0,0 +1,111 @@
+
+/*
+ * Polyphase FIR decimator
+ *
+ * The history is written twice, at pos and pos + len,
+ * so the latest len samples are always contiguous.
+ */
+
+#include <math.h>
+
+#include "fir.h"
+
+// Taps are Q15 with a DC gain of 1
+#define FIR_FRAC 15
+
+static int16_t*  _fir_taps;  // Symmetric, no need to reverse
+static uint16_t* _fir_hist;
+static size_t    _fir_len;
+static size_t    _fir_pos;
+static uint8_t   _fir_factor;
+static uint8_t   _fir_phase;
+static uint8_t   _fir_shift;
+static uint32_t  _fir_max;
+
+
+// Windowed sinc, cutoff at 1 / (2 factor) of the input rate
+static double fir_tap(size_t i, size_t len, uint8_t factor)
+{
+    double t = (i - (len - 1) / 2.0) / factor;
+    double h = t == 0 ? 1.0 : sin(M_PI * t) / (M_PI * t);
+    return h * (0.54 - 0.46 * cos(2 * M_PI * i / (len - 1)));
+}
+
+
+void fir_init(int16_t* taps,
+              uint16_t* hist,
+              uint8_t factor,
+              uint8_t taps_per_phase,
+              uint8_t bits)
+{
+    size_t len = factor * taps_per_phase;
+
+    double sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        sum += fir_tap(i, len, factor);
+    }
+
+    // Normalize, the rounding error goes into the center tap
+    int32_t total = 0;
+    for (size_t i = 0; i < len; i++) {
+        taps[i] = round(fir_tap(i, len, factor) / sum * (1 << FIR_FRAC));
+        total += taps[i];
+    }
+    taps[len / 2] += (1 << FIR_FRAC) - total;
+
+    _fir_taps = taps;
+    _fir_hist = hist;
+    _fir_len = len;
+    _fir_factor = factor;
+    _fir_shift = FIR_FRAC - bits;
+    _fir_max = (1 << (12 + bits)) - 1;
+
+    fir_reset();
+}
+
+
+void fir_reset()
+{
+    for (size_t i = 0; i < 2 * _fir_len; i++) {
+        _fir_hist[i] = 1 << 11;
+    }
+    _fir_pos = 0;
+    _fir_phase = 0;
+}
+
+
+size_t fir_decimate(uint16_t* out, size_t stride,
+                    const uint16_t* block, size_t len)
+{
+    size_t n = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        _fir_hist[_fir_pos] = block[i];
+        _fir_hist[_fir_pos + _fir_len] = block[i];
+        _fir_pos = _fir_pos + 1 == _fir_len ? 0 : _fir_pos + 1;
+
+        if (++_fir_phase < _fir_factor) {
+            continue;
+        }
+        _fir_phase = 0;
+
+        // The latest samples, oldest first
+        const uint16_t* x = _fir_hist + _fir_pos;
+        int32_t acc = 1 << (_fir_shift - 1);
+        for (size_t k = 0; k < _fir_len; k++) {
+            acc += _fir_taps[k] * x[k];
+        }
+
+        // Ringing may overshoot the ADC range
+        acc >>= _fir_shift;
+        if (acc < 0) {
+            acc = 0;
+        }
+        else if (acc > (int32_t)_fir_max) {
+            acc = _fir_max;
+        }
+        out[stride * n++] = acc;
+    }
+
+    return n;
+}
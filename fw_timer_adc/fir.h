@@ -0,0 +1,43 @@
+#ifndef _FIR_H_
+#define _FIR_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Polyphase FIR decimator: Lowpass filter raw ADC samples
+ * and keep every factor-th output. Only the kept outputs
+ * are calculated, each from the last factor * taps_per_phase
+ * samples, so the cost per input sample is taps_per_phase
+ * multiplications.
+ *
+ * The lowpass is a Hamming windowed sinc with the cutoff
+ * at the output Nyquist frequency; with 16 taps per phase
+ * the output is free of aliases up to 80% of it.
+ *
+ * The history is carried from block to block. The taps
+ * (factor * taps_per_phase) and the history (twice that)
+ * are provided by the caller.
+ */
+
+void fir_init(int16_t* taps,
+              uint16_t* hist,
+              uint8_t factor,
+              uint8_t taps_per_phase,
+              uint8_t bits);
+
+// Clear the history
+void fir_reset();
+
+/*
+ * Decimate a block of 12 bit samples. The outputs have
+ * 12 + bits bits and are written to every stride-th half
+ * word of out. The phase is kept, the block length does
+ * not have to be a multiple of the factor.
+ *
+ * Returns the number of decimated samples.
+ */
+size_t fir_decimate(uint16_t* out, size_t stride,
+                    const uint16_t* block, size_t len);
+
+#endif
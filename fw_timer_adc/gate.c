@@ -0,0 +1,57 @@
+
+/*
+ * Energy gate with hysteresis
+ */
+
+#include "gate.h"
+
+static uint32_t _gate_open_level;
+static uint32_t _gate_close_level;
+static uint16_t _gate_hold;
+static uint16_t _gate_heartbeat;
+
+static uint8_t  _gate_open;
+static uint16_t _gate_count; // Quiet frames while open, frames while closed
+
+
+void gate_init(uint32_t open_level,
+               uint32_t close_level,
+               uint16_t hold,
+               uint16_t heartbeat)
+{
+    _gate_open_level = open_level;
+    _gate_close_level = close_level;
+    _gate_hold = hold;
+    _gate_heartbeat = heartbeat;
+
+    _gate_open = 0;
+    _gate_count = 0;
+}
+
+
+uint8_t gate_update(uint32_t level)
+{
+    if (_gate_open) {
+        if (level >= _gate_close_level) {
+            _gate_count = 0;
+        } else if (++_gate_count >= _gate_hold) {
+            _gate_open = 0;
+            _gate_count = 0;
+        }
+        return GATE_OPEN;
+    }
+
+    if (level > _gate_open_level) {
+        _gate_open = 1;
+        _gate_count = 0;
+        return GATE_OPEN;
+    }
+
+    _gate_count++;
+    if (_gate_heartbeat && _gate_count >= _gate_heartbeat) {
+        _gate_count = 0;
+        return GATE_HEARTBEAT;
+    }
+
+    return GATE_CLOSED;
+}
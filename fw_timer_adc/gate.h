@@ -0,0 +1,27 @@
+#ifndef _GATE_H_
+#define _GATE_H_
+
+#include <stdint.h>
+
+/*
+ * Energy gate: Frames are only passed while the signal
+ * level is above a threshold. The gate opens above
+ * open_level and closes after the level stayed below
+ * close_level for hold frames.
+ *
+ * While closed, every heartbeat-th frame is reported
+ * as heartbeat (0 disables heartbeats).
+ */
+
+#define GATE_CLOSED    0
+#define GATE_OPEN      1
+#define GATE_HEARTBEAT 2
+
+void gate_init(uint32_t open_level,
+               uint32_t close_level,
+               uint16_t hold,
+               uint16_t heartbeat);
+
+uint8_t gate_update(uint32_t level);
+
+#endif
@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+
+"""
+Generate the band edge tables for the firmware.
+
+Edges are in Hz, up to 20 kHz or the nyquist frequency
+of the sample rate. Bands narrower than a bin of the
+longest frame are joined with the next one. The firmware
+maps the edges to FFT bins.
+
+Usage: gen_bands.py <sample rate> <frame length> > band_tables.c
+"""
+
+import math
+import sys
+
+SAMPLE_RATE = int(sys.argv[1])
+FRAME_LEN = int(sys.argv[2])  # Samples
+
+F_MAX = min(20000, SAMPLE_RATE / 2)
+BIN_WIDTH = SAMPLE_RATE / FRAME_LEN
+
+
+def linear(count):
+    return [F_MAX * i / count for i in range(count + 1)]
+
+
+def mel(count):
+    def to_mel(f):
+        return 2595 * math.log10(1 + f / 700)
+
+    def from_mel(m):
+        return 700 * (10**(m / 2595) - 1)
+
+    m_max = to_mel(F_MAX)
+    return [from_mel(m_max * i / count) for i in range(count + 1)]
+
+
+def third_octave():
+    # Nominal centers 25 Hz .. 20 kHz around 1 kHz
+    edges = [1000 * 2**((n - 0.5) / 3) for n in range(-16, 15)]
+    return [f for f in edges if f < F_MAX] + [F_MAX]
+
+
+def join_narrow(edges):
+    joined = edges[:1]
+    for f in edges[1:]:
+        if f - joined[-1] >= BIN_WIDTH:
+            joined.append(f)
+
+    # Keep the upper edge, the last band gets wider
+    if joined[-1] != edges[-1]:
+        if len(joined) > 1:
+            joined[-1] = edges[-1]
+        else:
+            joined.append(edges[-1])
+    return joined
+
+
+# Order must match the BANDS_* ids in bands.h
+SCALES = [
+    ("linear", join_narrow(linear(32))),
+    ("mel", join_narrow(mel(32))),
+    ("third_octave", join_narrow(third_octave())),
+]
+
+
+def table(name, edges):
+    values = [round(f) for f in edges]
+
+    lines = []
+    for i in range(0, len(values), 8):
+        lines.append("    " + ", ".join(
+            "{:5d}".format(v) for v in values[i:i+8]) + ",")
+
+    return "static const uint16_t bands_{}[{}] = {{\n{}\n}};\n".format(
+        name, len(values), "\n".join(lines))
+
+
+def main():
+    print("/*")
+    print(" * Generated by gen_bands.py, do not edit.")
+    print(" */")
+    print("")
+    print("#include \"bands.h\"")
+    print("")
+
+    for name, edges in SCALES:
+        print(table(name, edges))
+
+    print("const uint16_t* const band_edges[BANDS_SCALES] = {")
+    for name, _ in SCALES:
+        print("    bands_{},".format(name))
+    print("};")
+    print("")
+
+    print("const uint8_t band_counts[BANDS_SCALES] = {")
+    for _, edges in SCALES:
+        print("    {},".format(len(edges) - 1))
+    print("};")
+
+
+if __name__ == "__main__":
+    main()
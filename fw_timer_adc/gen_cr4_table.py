@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+
+"""
+Extract the twiddle table TableFFT_V7 from the assembly
+FFT for the host build of cr4_fft_ref.c.
+
+On the target cr4_fft_ref uses the table in the assembly
+directly, this copies the literal values so both builds
+run on the same coefficients.
+
+Usage: gen_cr4_table.py cr4_fft_1024_stm32.s > cr4_table.c
+"""
+
+import sys
+
+TABLE_LEN = 3 * (4 + 16 + 64 + 256)
+
+
+def parse(path):
+    values = []
+    in_table = False
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if line.startswith("TableFFT_V7:"):
+                in_table = True
+            elif in_table and line.startswith(".short"):
+                values += [int(v, 16) for v in line[6:].split(",")]
+            elif in_table and line.startswith(".end"):
+                break
+
+    # Stored as signed half words
+    values = [v - 0x10000 if v >= 0x8000 else v for v in values]
+    if len(values) != 2 * TABLE_LEN:
+        sys.exit("{}: expected {} twiddles, found {}".format(
+            path, TABLE_LEN, len(values) // 2))
+
+    return values
+
+
+def main():
+    values = parse(sys.argv[1])
+
+    print("/*")
+    print(" * Generated by gen_cr4_table.py, do not edit.")
+    print(" */")
+    print("")
+    print("#include <stdint.h>")
+    print("")
+    print("const int16_t TableFFT_V7[{}][2] = {{".format(TABLE_LEN))
+    for i in range(0, len(values), 6):
+        print("    " + " ".join(
+            "{{{:6d}, {:6d}}},".format(values[j], values[j + 1])
+            for j in range(i, i + 6, 2)))
+    print("};")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,43 @@
+#!/usr/bin/env python3
+
+"""
+Generate the twiddle tables for the real FFT split stage.
+
+For k = 0 .. N/2 the tables hold cos and sin of pi k / N
+in Q15, N is RFFT_LEN in rfft.h.
+
+Usage: gen_rfft.py > rfft_tables.c
+"""
+
+import math
+
+RFFT_LEN = 1024  # Must match rfft.h
+
+
+def table(name, func):
+    values = [round(func(math.pi * k / RFFT_LEN) * 32767)
+              for k in range(RFFT_LEN // 2 + 1)]
+
+    lines = []
+    for i in range(0, len(values), 8):
+        lines.append("    " + ", ".join(
+            "{:6d}".format(v) for v in values[i:i+8]) + ",")
+
+    return "const int16_t rfft_{}[{}] = {{\n{}\n}};\n".format(
+        name, len(values), "\n".join(lines))
+
+
+def main():
+    print("/*")
+    print(" * Generated by gen_rfft.py, do not edit.")
+    print(" */")
+    print("")
+    print("#include \"rfft.h\"")
+    print("")
+
+    print(table("cos", math.cos))
+    print(table("sin", math.sin))
+
+
+if __name__ == "__main__":
+    main()
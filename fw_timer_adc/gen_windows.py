@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+
+"""
+Generate the window tables for the firmware.
+
+Windows are periodic (DFT even) of length WINDOW_LEN, so
+a window for a frame of WINDOW_LEN / step samples is every
+step-th weight. Only the first half up to and including
+the center is stored, the window is symmetric around it.
+
+Weights are signed Q15, the flat-top window has small
+negative lobes.
+
+Usage: gen_windows.py > window_tables.c
+"""
+
+import math
+
+WINDOW_LEN = 2048  # Longest frame: real FFT of 1024 points
+
+
+def cosine_sum(coeffs):
+    def window(n):
+        x = 2 * math.pi * n / WINDOW_LEN
+        return sum((-1)**k * a * math.cos(k * x)
+                   for k, a in enumerate(coeffs))
+    return window
+
+
+# Order must match the WINDOW_* ids in window.h
+WINDOWS = [
+    ("hann", cosine_sum([0.5, 0.5])),
+    ("hamming", cosine_sum([0.54, 0.46])),
+    ("blackman_harris", cosine_sum([0.35875, 0.48829, 0.14128, 0.01168])),
+    ("flattop", cosine_sum([0.21557895, 0.41663158, 0.277263158,
+                            0.083578947, 0.006947368])),
+]
+
+
+def q15(value):
+    return max(-32768, min(32767, round(value * 32768)))
+
+
+def table(name, window):
+    weights = [q15(window(n)) for n in range(WINDOW_LEN // 2 + 1)]
+
+    lines = []
+    for i in range(0, len(weights), 8):
+        lines.append("    " + ", ".join(
+            "{:6d}".format(w) for w in weights[i:i+8]) + ",")
+
+    return "const int16_t window_{}[WINDOW_LEN / 2 + 1] = {{\n{}\n}};\n".format(
+        name, "\n".join(lines))
+
+
+def main():
+    print("/*")
+    print(" * Generated by gen_windows.py, do not edit.")
+    print(" */")
+    print("")
+    print("#include \"window.h\"")
+    print("")
+
+    for name, window in WINDOWS:
+        print(table(name, window))
+
+    print("const int16_t* const window_tables[WINDOW_COUNT] = {")
+    for name, _ in WINDOWS:
+        print("    window_{},".format(name))
+    print("};")
+    print("")
+
+    print("const char* const window_names[WINDOW_COUNT] = {")
+    for name, _ in WINDOWS:
+        print("    \"{}\",".format(name))
+    print("};")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,109 @@
+
+/*
+ * Fixed point Goertzel filter bank
+ *
+ *   s[n] = x[n] + c s[n-1] - s[n-2],  c = 2 cos(2 pi f / fs)
+ *
+ * After N samples the power is
+ *
+ *   |X|^2 = s[n-1]^2 + s[n-2]^2 - c s[n-1] s[n-2]
+ *
+ * and the amplitude of a sine at f is 2 |X| / N.
+ */
+
+#include <math.h>
+
+#include "goertzel.h"
+#include "sqrt.h"
+
+// Coefficients are Q14, c is in -2 .. 2
+#define GOERTZEL_FRAC 14
+
+static int32_t  _goertzel_coeff[GOERTZEL_MAX];
+static int32_t  _goertzel_s1[GOERTZEL_MAX];
+static int32_t  _goertzel_s2[GOERTZEL_MAX];
+static uint32_t _goertzel_amp[GOERTZEL_MAX];
+
+static size_t  _goertzel_count;
+static uint8_t _goertzel_shift;
+static size_t  _goertzel_pos;
+
+
+void goertzel_init(const uint32_t* freqs,
+                   size_t count,
+                   uint32_t sample_rate,
+                   uint8_t len_shift)
+{
+    if (count > GOERTZEL_MAX) {
+        count = GOERTZEL_MAX;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        _goertzel_coeff[i] = round(2 * cos(2 * M_PI * freqs[i] / sample_rate)
+                                   * (1 << GOERTZEL_FRAC));
+        _goertzel_s1[i] = 0;
+        _goertzel_s2[i] = 0;
+        _goertzel_amp[i] = 0;
+    }
+
+    _goertzel_count = count;
+    _goertzel_shift = len_shift;
+    _goertzel_pos = 0;
+}
+
+
+static void goertzel_finish()
+{
+    for (size_t i = 0; i < _goertzel_count; i++) {
+        int64_t s1 = _goertzel_s1[i];
+        int64_t s2 = _goertzel_s2[i];
+        // Scale c s1 back first, c s1 s2 can exceed 64 bit
+        int64_t power = s1 * s1 + s2 * s2 -
+                        ((_goertzel_coeff[i] * s1) >> GOERTZEL_FRAC) * s2;
+
+        // (2 / N)^2, the squared amplitude fits 32 bit
+        power >>= 2 * (_goertzel_shift - 1);
+        _goertzel_amp[i] = fast_sqrt_newton(power);
+
+        _goertzel_s1[i] = 0;
+        _goertzel_s2[i] = 0;
+    }
+}
+
+
+uint8_t goertzel_feed(const uint16_t* samples, size_t n, dc_filter_t* dc)
+{
+    uint8_t done = 0;
+
+    for (size_t k = 0; k < n; k++) {
+        int32_t x = dc_filter_step(dc, samples[k]);
+
+        for (size_t i = 0; i < _goertzel_count; i++) {
+            int32_t s = x + (int32_t)(((int64_t)_goertzel_coeff[i] *
+                                       _goertzel_s1[i]) >> GOERTZEL_FRAC)
+                          - _goertzel_s2[i];
+            _goertzel_s2[i] = _goertzel_s1[i];
+            _goertzel_s1[i] = s;
+        }
+
+        if (++_goertzel_pos == (1u << _goertzel_shift)) {
+            goertzel_finish();
+            _goertzel_pos = 0;
+            done = 1;
+        }
+    }
+
+    return done;
+}
+
+
+uint32_t goertzel_amplitude(size_t i)
+{
+    return _goertzel_amp[i];
+}
+
+
+size_t goertzel_count()
+{
+    return _goertzel_count;
+}
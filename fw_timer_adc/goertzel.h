@@ -0,0 +1,37 @@
+#ifndef _GOERTZEL_H_
+#define _GOERTZEL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "dc_filter.h"
+
+/*
+ * Goertzel filter bank: Evaluates the amplitude of a few
+ * target frequencies over blocks of 1 << len_shift samples,
+ * updated with every sample as it arrives.
+ *
+ * Costs one multiplication per sample and tone, instead
+ * of a full FFT per frame.
+ */
+
+#define GOERTZEL_MAX 16
+
+void goertzel_init(const uint32_t* freqs,
+                   size_t count,
+                   uint32_t sample_rate,
+                   uint8_t len_shift);
+
+/*
+ * Feed raw samples, the offset is removed by dc.
+ * Returns 1 when a block was completed, the amplitudes
+ * are available until the next block completes.
+ */
+uint8_t goertzel_feed(const uint16_t* samples, size_t n, dc_filter_t* dc);
+
+// Amplitude of tone i in ADC steps
+uint32_t goertzel_amplitude(size_t i);
+
+size_t goertzel_count();
+
+#endif
@@ -0,0 +1,137 @@
+
+/*
+ * Radix-2 decimation in time inverse FFT
+ *
+ * The cr4 FFT can not be used with the conjugation trick:
+ * Its 1/len scaling would cost log2(len) bits of the result.
+ *
+ * Twiddles of a pass are rotated by a Q30 step instead of
+ * being read from a table.
+ */
+
+#include <math.h>
+
+#include "ifft.h"
+#include "fft.h"
+
+#define C_REAL(X) ((int16_t)((X) & 0xffff))
+#define C_IMAG(X) ((int16_t)((X) >> 16))
+#define C_PACK(RE, IM) (((uint32_t)(uint16_t)(IM) << 16) | (uint16_t)(RE))
+
+#define IFFT_STEP_FRAC 30
+
+/*
+ * A butterfly output is at most (1 + sqrt 2) times the
+ * largest input component.
+ */
+#define IFFT_SAFE_1 13573  // No scaling
+#define IFFT_SAFE_2 27146  // Scaling by 1/2
+
+// exp(j pi / half) for half = 1, 2, 4, ...
+static int32_t _ifft_step[16][2];
+static uint8_t _ifft_step_ready;
+
+
+static void ifft_step_init()
+{
+    for (size_t s = 0; (1u << s) < FFT_MAX_LEN; s++) {
+        double theta = M_PI / (1 << s);
+        _ifft_step[s][0] = round(cos(theta) * (1 << IFFT_STEP_FRAC));
+        _ifft_step[s][1] = round(sin(theta) * (1 << IFFT_STEP_FRAC));
+    }
+
+    _ifft_step_ready = 1;
+}
+
+
+static void ifft_bitrev(uint32_t* values, size_t len)
+{
+    size_t j = 0;
+    for (size_t i = 0; i < len - 1; i++) {
+        if (i < j) {
+            uint32_t t = values[i];
+            values[i] = values[j];
+            values[j] = t;
+        }
+
+        size_t bit = len >> 1;
+        while (j & bit) {
+            j ^= bit;
+            bit >>= 1;
+        }
+        j |= bit;
+    }
+}
+
+
+static inline int32_t ifft_abs_max(int32_t m, int32_t v)
+{
+    if (v < 0) {
+        v = -v;
+    }
+    return v > m ? v : m;
+}
+
+
+uint8_t ifft_transform(uint32_t* values, size_t len)
+{
+    if (!_ifft_step_ready) {
+        ifft_step_init();
+    }
+
+    ifft_bitrev(values, len);
+
+    int32_t m = 0;
+    for (size_t i = 0; i < len; i++) {
+        m = ifft_abs_max(m, C_REAL(values[i]));
+        m = ifft_abs_max(m, C_IMAG(values[i]));
+    }
+
+    uint8_t shift = 0;
+    size_t s = 0;
+    for (size_t half = 1; half < len; half <<= 1, s++) {
+        uint8_t scale = m > IFFT_SAFE_2 ? 2 : m > IFFT_SAFE_1 ? 1 : 0;
+        shift += scale;
+        m = 0;
+
+        // Twiddle exp(j pi k / half), Q30
+        int32_t wr = 1 << IFFT_STEP_FRAC;
+        int32_t wi = 0;
+
+        for (size_t k = 0; k < half; k++) {
+            int32_t c = wr >> (IFFT_STEP_FRAC - 15);
+            int32_t d = wi >> (IFFT_STEP_FRAC - 15);
+
+            for (size_t i = k; i < len; i += 2 * half) {
+                int32_t ar = C_REAL(values[i]);
+                int32_t ai = C_IMAG(values[i]);
+                int32_t br = C_REAL(values[i + half]);
+                int32_t bi = C_IMAG(values[i + half]);
+
+                int32_t tr = (c * br - d * bi + (1 << 14)) >> 15;
+                int32_t ti = (c * bi + d * br + (1 << 14)) >> 15;
+
+                int32_t xr = (ar + tr) >> scale;
+                int32_t xi = (ai + ti) >> scale;
+                int32_t yr = (ar - tr) >> scale;
+                int32_t yi = (ai - ti) >> scale;
+
+                m = ifft_abs_max(m, xr);
+                m = ifft_abs_max(m, xi);
+                m = ifft_abs_max(m, yr);
+                m = ifft_abs_max(m, yi);
+
+                values[i] = C_PACK(xr, xi);
+                values[i + half] = C_PACK(yr, yi);
+            }
+
+            int64_t sr = _ifft_step[s][0];
+            int64_t si = _ifft_step[s][1];
+            int32_t t = (wr * sr - wi * si) >> IFFT_STEP_FRAC;
+            wi = (wr * si + wi * sr) >> IFFT_STEP_FRAC;
+            wr = t;
+        }
+    }
+
+    return shift;
+}
@@ -0,0 +1,22 @@
+#ifndef _IFFT_H_
+#define _IFFT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Inverse complex FFT, len a power of 2 up to FFT_MAX_LEN,
+ * in place on the packed 16 bit format of the FFT.
+ *
+ * No 1/len scaling: The forward FFT scales by 1/len, so
+ * the inverse of its output restores the original scale.
+ * For real input the conjugate of the result is the
+ * unscaled forward DFT.
+ *
+ * Block floating point: A pass which could overflow is
+ * scaled by 1/2 or 1/4. Returns the total shift, the
+ * result has to be multiplied by 2^shift.
+ */
+uint8_t ifft_transform(uint32_t* values, size_t len);
+
+#endif
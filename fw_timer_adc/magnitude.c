@@ -0,0 +1,71 @@
+
+/*
+ * Magnitude strategies for the FFT result
+ */
+
+#include "magnitude.h"
+#include "sqrt.h"
+
+#define C_REAL(X) ((int16_t)((X) & 0xffff))
+#define C_IMAG(X) ((int16_t)((X) >> 16))
+
+// Q15
+#define MAGNITUDE_ALPHA 31471
+#define MAGNITUDE_BETA  13036
+
+
+static inline uint32_t magnitude_power(uint32_t x)
+{
+    int32_t re = C_REAL(x);
+    int32_t im = C_IMAG(x);
+
+    // Up to 2^31, does not fit signed
+    return (uint32_t)(re * re) + (uint32_t)(im * im);
+}
+
+
+static inline uint32_t magnitude_alpha_beta(uint32_t x)
+{
+    int32_t re = C_REAL(x);
+    int32_t im = C_IMAG(x);
+    uint32_t a = re < 0 ? -re : re;
+    uint32_t b = im < 0 ? -im : im;
+
+    if (a < b) {
+        uint32_t t = a;
+        a = b;
+        b = t;
+    }
+
+    return (MAGNITUDE_ALPHA * a + MAGNITUDE_BETA * b) >> 15;
+}
+
+
+void magnitude_apply(uint8_t method, uint32_t* values, size_t len)
+{
+    switch (method) {
+        case MAGNITUDE_ABACUS:
+            for (size_t i = 0; i < len; i++) {
+                values[i] = fast_sqrt(magnitude_power(values[i]));
+            }
+            break;
+
+        case MAGNITUDE_POWER:
+            for (size_t i = 0; i < len; i++) {
+                values[i] = magnitude_power(values[i]);
+            }
+            break;
+
+        case MAGNITUDE_ALPHA_BETA:
+            for (size_t i = 0; i < len; i++) {
+                values[i] = magnitude_alpha_beta(values[i]);
+            }
+            break;
+
+        case MAGNITUDE_NEWTON:
+            for (size_t i = 0; i < len; i++) {
+                values[i] = fast_sqrt_newton(magnitude_power(values[i]));
+            }
+            break;
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef _MAGNITUDE_H_
+#define _MAGNITUDE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Magnitude of complex FFT bins, replaced in place.
+ *
+ * Methods and their error:
+ *  - ABACUS: Bit serial sqrt, exact (floor). ~16 iterations
+ *    per bin, the reference.
+ *  - POWER: re^2 + im^2, no sqrt at all. Exact, but the
+ *    result is the squared magnitude.
+ *  - ALPHA_BETA: alpha * max + beta * min with alpha = 0.96043,
+ *    beta = 0.39782. Within -4.2% .. +4.0% of magnitudes
+ *    from 256 up, below truncation adds up to 1 LSB.
+ *  - NEWTON: CLZ normalized table seed and one newton step,
+ *    exact (floor).
+ *
+ * The errors were swept on the host over the full input
+ * range. With BENCH in main.c every frame prints the DWT
+ * cycles of each method, in total and per bin, on a copy
+ * of the spectrum. No target figures are recorded here yet.
+ */
+
+#define MAGNITUDE_ABACUS     0
+#define MAGNITUDE_POWER      1
+#define MAGNITUDE_ALPHA_BETA 2
+#define MAGNITUDE_NEWTON     3
+
+#define MAGNITUDE_COUNT 4
+
+void magnitude_apply(uint8_t method, uint32_t* values, size_t len);
+
+#endif
@@ -9,6 +9,8 @@
 #include <math.h>
 
 #include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/dwt.h>
 #include <libopencm3/stm32/rcc.h>
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/adc.h>
@@ -16,75 +18,747 @@
 #include <libopencm3/stm32/timer.h>
 
 #include "usb_serial.h"
+#include "fft.h"
 #include "cr4_fft.h"
-#include "sqrt.h"
+#include "magnitude.h"
+#include "db.h"
+#include "bands.h"
+#include "welch.h"
+#include "accum.h"
+#include "scope.h"
+#include "condition.h"
+#include "dc_filter.h"
+#include "biquad.h"
+#include "fir.h"
+#include "agc.h"
+#include "gate.h"
+#include "goertzel.h"
+#include "sdft.h"
+#include "ola.h"
+#include "rfft.h"
+#include "window.h"
 
 #define MIC_RCC  RCC_GPIOA
 #define MIC_PORT GPIOA
 #define MIC_PIN  GPIO0
 
-#define FFT_LEN 1024
-#define SAMPLE_BUF_LEN 1024
-uint16_t _adc_samples[SAMPLE_BUF_LEN];
-uint32_t _fft_data[SAMPLE_BUF_LEN];
-uint32_t _fft_result[SAMPLE_BUF_LEN];
-uint16_t _fft_window[SAMPLE_BUF_LEN];
+// Buffer size, the FFT length can be reduced at runtime
+#define FFT_LEN FFT_MAX_LEN
 
-#define C_REAL(X) (X & 0xffff)
-#define C_IMAG(X) (X >> 16)
+/*
+ * Operation modes:
+ *  - FFT: Stream the spectrum of every frame
+ *  - SCOPE: Capture a window around a trigger event
+ *  - EVENT: Sleep until the analog watchdog sees the signal
+ *           leave a window and report the burst around it
+ *  - TONES: Track the amplitude of a few known frequencies
+ *           with a Goertzel filter bank, sample by sample
+ *  - SDFT: Sliding DFT of a few bins, report a tone as soon
+ *          as it crosses a level
+ *  - FILTER: Stream the signal filtered in the frequency
+ *            domain (overlap-add)
+ */
+#define MODE_FFT   0
+#define MODE_SCOPE 1
+#define MODE_EVENT 2
+#define MODE_TONES 3
+#define MODE_SDFT  4
+#define MODE_FILTER 5
+
+#define MODE MODE_FFT
+// #define MODE MODE_SCOPE
+// #define MODE MODE_EVENT
+// #define MODE MODE_TONES
+// #define MODE MODE_SDFT
+// #define MODE MODE_FILTER
+
+/*
+ * Real FFT: Two consecutive samples are packed into one
+ * complex FFT input value, the result is split into the
+ * spectrum of the real signal. A frame of 2 * FFT_LEN
+ * samples is transformed at the cost of a FFT_LEN point
+ * FFT, doubling the frequency resolution.
+ */
+#define FFT_REAL 1
+// #define FFT_REAL 0
+
+#define FFT_PACKED (FFT_REAL && MODE == MODE_FFT)
+
+#if FFT_PACKED
+#define SAMPLE_BUF_LEN (2 * FFT_LEN)
+#else
+#define SAMPLE_BUF_LEN FFT_LEN
+#endif
+
+/*
+ * Welch averaging: Frames overlap, a new one starts every
+ * frame length / FFT_WELCH_HOP_DIV samples (rounded up to
+ * whole DMA blocks). The power spectra of
+ * 1 << FFT_WELCH_FRAMES_SHIFT frames are averaged before
+ * output. At most 16 frames fit the 32 bit accumulator.
+ */
+#define FFT_WELCH 0
+// #define FFT_WELCH 1
+
+#define FFT_WELCH_HOP_DIV      2
+#define FFT_WELCH_FRAMES_SHIFT 3
+
+#if FFT_WELCH && MODE != MODE_FFT
+#error "Welch averaging needs FFT mode"
+#endif
+
+#if FFT_WELCH_FRAMES_SHIFT > 4
+#error "Welch averaging of more than 16 frames may overflow"
+#endif
+
+// Scope trigger and pre-/post-trigger samples
+#define SCOPE_TRIGGER_LEVEL      (ADC_SAMPLE_MID + ADC_SAMPLE_MID / 4)
+#define SCOPE_TRIGGER_HYSTERESIS (ADC_SAMPLE_MID / 32)
+#define SCOPE_TRIGGER_EDGE       SCOPE_EDGE_RISING
+#define SCOPE_PRE_TRIGGER        256
+#define SCOPE_POST_TRIGGER       768
+
+// Analog watchdog window and samples around an event
+#define EVENT_THRESHOLD_LOW  (2048 - 512)
+#define EVENT_THRESHOLD_HIGH (2048 + 512)
+#define EVENT_PRE            256
+#define EVENT_POST           256
+
+// Tone frequencies in Hz and samples per result (1 << shift)
+#define TONE_FREQS     { 440, 1000, 2000, 4000 }
+#define TONE_LEN_SHIFT 10
+
+/*
+ * Sliding DFT: Bins of a 1 << SDFT_LEN_SHIFT point DFT,
+ * at bin * ADC_SAMPLE_RATE / len Hz. A bin switches on
+ * above SDFT_ON_LEVEL and off below SDFT_OFF_LEVEL (in
+ * ADC steps). The amplitudes are reported every
+ * SDFT_REPORT_EVERY DMA blocks.
+ */
+#define SDFT_LEN_SHIFT    8
+#define SDFT_BINS         { 8, 16, 32 }
+#define SDFT_ON_LEVEL     200
+#define SDFT_OFF_LEVEL    100
+#define SDFT_REPORT_EVERY 125
+
+/*
+ * Frequency domain filter: A FIR band pass from FILTER_LOW
+ * to FILTER_HIGH Hz with FILTER_TAPS taps, applied with
+ * overlap-add of FILTER_FFT_LEN point FFTs. Every FFT
+ * yields FILTER_FFT_LEN / 2 filtered samples, the FIR
+ * may have one tap more.
+ */
+#define FILTER_FFT_LEN 1024
+#define FILTER_LOW     300
+#define FILTER_HIGH    3400
+#define FILTER_TAPS    255
+
+#define FILTER_HOP (FILTER_FFT_LEN / 2)
+
+#if FILTER_FFT_LEN != 64 && FILTER_FFT_LEN != 256 && FILTER_FFT_LEN != 1024
+#error "FILTER_FFT_LEN must be 64, 256 or 1024"
+#endif
+
+#if FILTER_TAPS > FILTER_HOP + 1
+#error "The FIR does not fit the overlap"
+#endif
+
+/*
+ * Sampling rate after decimation, set with SAMPLE_RATE
+ * in the Makefile: The band tables are generated for it.
+ * E.g. 40000, 30000, 20000 or 6000.
+ */
+#ifndef ADC_SAMPLE_RATE
+#define ADC_SAMPLE_RATE 40000
+#endif
+
+/*
+ * Oversampling: The ADC runs at 4^ADC_OVERSAMPLE_BITS times
+ * the sampling rate, the samples are accumulated in the
+ * DMA half transfer handler and decimated. Every 4x
+ * oversampling gains one bit of effective resolution.
+ *
+ * 0 disables oversampling.
+ */
+#define ADC_OVERSAMPLE_BITS 0
+// #define ADC_OVERSAMPLE_BITS 2 // 6 kHz -> 96 kHz, 14 bit
+
+/*
+ * Decimation filter:
+ *  - BOXCAR: Sum up the oversampled samples, cheap but
+ *            aliases pass with little attenuation
+ *  - FIR: Polyphase FIR lowpass, any factor 2 .. 16 given
+ *         by ADC_FIR_FACTOR, with ADC_FIR_TAPS taps per
+ *         phase. The output has ADC_OVERSAMPLE_BITS extra
+ *         bits.
+ */
+#define ADC_DECIMATOR_BOXCAR 0
+#define ADC_DECIMATOR_FIR    1
+
+#define ADC_DECIMATOR ADC_DECIMATOR_BOXCAR
+// #define ADC_DECIMATOR ADC_DECIMATOR_FIR
+
+#define ADC_FIR_FACTOR 4
+#define ADC_FIR_TAPS   16
+
+#if ADC_DECIMATOR == ADC_DECIMATOR_FIR
+#define ADC_OVERSAMPLE ADC_FIR_FACTOR
+#else
+#define ADC_OVERSAMPLE (1 << (2 * ADC_OVERSAMPLE_BITS))
+#endif
+
+#if ADC_DECIMATOR == ADC_DECIMATOR_FIR && \
+    (ADC_FIR_FACTOR < 2 || ADC_FIR_FACTOR > 16)
+#error "FIR decimation factor must be 2 .. 16"
+#endif
+#define ADC_CONVERSION_RATE (ADC_SAMPLE_RATE * ADC_OVERSAMPLE)
+
+// 72 MHz clock, e.g. 40 kHz sampling freq: 1800 cycles
+#define ADC_TIMER_PERIOD (72000000 / ADC_CONVERSION_RATE)
+
+// Resolution of a (decimated) sample
+#define ADC_SAMPLE_BITS (12 + ADC_OVERSAMPLE_BITS)
+#define ADC_SAMPLE_MAX  ((1 << ADC_SAMPLE_BITS) - 1)
+#define ADC_SAMPLE_MID  (1 << (ADC_SAMPLE_BITS - 1))
+
+// Gain in percent, the conditioning maps ADC_SAMPLE_BITS
+// to the 16 bit FFT input with this shift.
+#define ADC_GAIN 150
+#define ADC_GAIN_SHIFT (ADC_SAMPLE_BITS - 1)
+
+/*
+ * Automatic gain control: Keep the frame peak near
+ * full scale. The gain (Q15) is limited to 0.5 .. 64,
+ * it drops by 1/2 per frame when the signal gets louder
+ * and rises by 1/16 per frame when it gets quieter.
+ *
+ * With AGC disabled ADC_GAIN is used.
+ */
+#define ADC_AGC          1
+#define AGC_TARGET       28000
+#define AGC_ATTACK       1
+#define AGC_RELEASE      4
+#define AGC_MIN_GAIN     (1 << 14)
+#define AGC_MAX_GAIN     (64 << 15)
+
+/*
+ * Energy gate: Only transmit frames with a peak above
+ * ADC_GATE_OPEN (in ADC steps, before gain), until it
+ * stayed below ADC_GATE_CLOSE for ADC_GATE_HOLD frames.
+ * Quiet frames are suppressed, every ADC_GATE_HEARTBEAT-th
+ * sends the frame info lines only.
+ */
+#define ADC_GATE           1
+#define ADC_GATE_OPEN      (ADC_SAMPLE_MID / 64)
+#define ADC_GATE_CLOSE     (ADC_SAMPLE_MID / 128)
+#define ADC_GATE_HOLD      8
+#define ADC_GATE_HEARTBEAT 40
 
+// DC offset tracking time constant: 2^10 samples, ~6 Hz @ 40 kHz
+#define ADC_DC_SHIFT 10
 
-void fft_magnitude(uint32_t* values, size_t len)
+/*
+ * Filtering in the conditioning stage: A biquad cascade,
+ * by default a notch for mains hum at ADC_NOTCH_FREQ Hz
+ * (0 for none). It runs on the continuous stream, so the
+ * notch stays settled from frame to frame. In FFT mode the
+ * sections can be replaced with the "biquad" and "notch"
+ * commands.
+ */
+#define ADC_NOTCH_FREQ 50
+// #define ADC_NOTCH_FREQ 60
+// #define ADC_NOTCH_FREQ 0
+#define ADC_NOTCH_Q    5
+
+// Measure processing time with the DWT cycle counter
+#define BENCH 0
+
+// Compare the assembly FFT with cr4_fft_ref at startup, set
+// with "make FFT_REF_CHECK=1" which also links cr4_fft_ref.
+#ifndef FFT_REF_CHECK
+#define FFT_REF_CHECK 0
+#endif
+
+// Sample Vrefint and the temperature sensor (see Housekeeping)
+#define ADC_CAL 1
+
+// ADC clock is PCLK2 / 6 = 12 MHz (the maximum is 14 MHz),
+// a conversion takes 12.5 cycles + sample time.
+#define ADC_CLOCK 12000000
+#define ADC_TIMER_PER_ADC (72000000 / ADC_CLOCK)
+
+// Conversion time in timer cycles, the sample time is
+// given in half ADC cycles to stay integer.
+#define ADC_CONV_CYCLES(SMP_X2) (((25 + (SMP_X2)) * ADC_TIMER_PER_ADC) / 2)
+
+// The injected pair (71.5 cycles sample time each) starts
+// ADC_CAL_GAP timer cycles after the regular conversion and
+// has to end before the next one is triggered.
+#define ADC_CAL_GAP 32
+#if ADC_CAL
+#define ADC_CAL_CYCLES (ADC_CAL_GAP + 2 * ADC_CONV_CYCLES(143))
+#else
+#define ADC_CAL_CYCLES 0
+#endif
+
+#if ADC_CAL && ADC_CONV_CYCLES(3) + ADC_CAL_CYCLES > ADC_TIMER_PERIOD
+#error "Injected calibration does not fit the timer period, disable ADC_CAL"
+#endif
+
+// Use the longest sample time that fits the timer period
+#if ADC_CONV_CYCLES(111) + ADC_CAL_CYCLES <= ADC_TIMER_PERIOD
+#define ADC_SAMPLE_TIME ADC_SMPR_SMP_55DOT5CYC
+#define ADC_SAMPLE_CYCLES_X2 111
+#elif ADC_CONV_CYCLES(57) + ADC_CAL_CYCLES <= ADC_TIMER_PERIOD
+#define ADC_SAMPLE_TIME ADC_SMPR_SMP_28DOT5CYC
+#define ADC_SAMPLE_CYCLES_X2 57
+#elif ADC_CONV_CYCLES(27) + ADC_CAL_CYCLES <= ADC_TIMER_PERIOD
+#define ADC_SAMPLE_TIME ADC_SMPR_SMP_13DOT5CYC
+#define ADC_SAMPLE_CYCLES_X2 27
+#elif ADC_CONV_CYCLES(15) + ADC_CAL_CYCLES <= ADC_TIMER_PERIOD
+#define ADC_SAMPLE_TIME ADC_SMPR_SMP_7DOT5CYC
+#define ADC_SAMPLE_CYCLES_X2 15
+#elif ADC_CONV_CYCLES(3) + ADC_CAL_CYCLES <= ADC_TIMER_PERIOD
+#define ADC_SAMPLE_TIME ADC_SMPR_SMP_1DOT5CYC
+#define ADC_SAMPLE_CYCLES_X2 3
+#else
+// 14 ADC cycles per conversion: ~857 ksps
+#error "ADC conversion rate too high, reduce oversampling"
+#endif
+
+// Raw samples are streamed into a double buffer, except in
+// event mode. FFT frames are taken from the continuous,
+// filtered stream.
+#define ADC_STREAM (MODE != MODE_EVENT)
+
+// In event mode the FFT input is used as ring buffer
+// for raw samples, without any DMA interrupts.
+#if MODE == MODE_EVENT && ADC_OVERSAMPLE > 1
+#error "Event mode works on raw samples, disable oversampling"
+#endif
+
+// Short blocks keep the latency of the sliding DFT low.
+// With the FIR every block yields the same number of
+// samples, frames and histories fill up evenly.
+#if ADC_DECIMATOR == ADC_DECIMATOR_FIR
+#define ADC_DMA_BLOCK_LEN (32 * ADC_FIR_FACTOR)
+#elif MODE == MODE_SDFT
+#define ADC_DMA_BLOCK_LEN 32
+#else
+#define ADC_DMA_BLOCK_LEN 256
+#endif
+#if ADC_OVERSAMPLE > ADC_DMA_BLOCK_LEN
+#error "ADC_DMA_BLOCK_LEN must hold at least one decimated sample"
+#endif
+
+// The filter processes whole DMA blocks, nothing is left over
+#if MODE == MODE_FILTER && \
+    FILTER_HOP % (ADC_DMA_BLOCK_LEN / ADC_OVERSAMPLE) != 0
+#error "FILTER_HOP must be a multiple of the decimated DMA block"
+#endif
+
+size_t   _adc_samples_len;
+
+#if ADC_STREAM
+#define ADC_DMA_LEN (2 * ADC_DMA_BLOCK_LEN)
+uint16_t _adc_dma_buf[ADC_DMA_LEN];
+#else
+#define ADC_DMA_LEN SAMPLE_BUF_LEN
+#endif
+
+#if ADC_DECIMATOR == ADC_DECIMATOR_FIR
+#define ADC_FIR_LEN (ADC_FIR_FACTOR * ADC_FIR_TAPS)
+int16_t  _fir_taps[ADC_FIR_LEN];
+uint16_t _fir_hist[2 * ADC_FIR_LEN];
+#endif
+
+/*
+ * Sample clock: TIM3 counts the TIM2 update events, one per
+ * conversion, and is extended to 64 bit by its overflow
+ * interrupt.
+ */
+volatile uint32_t _clock_hi;
+
+// Conversion count after the last sample of the frame
+uint64_t _frame_clock;
+uint64_t _frame_next;  // Expected start of the next frame
+
+uint32_t _frame_count;
+uint32_t _frame_dropped;
+uint32_t _dma_overruns;
+
+#if MODE == MODE_SCOPE || MODE == MODE_FFT
+uint16_t _adc_block[ADC_DMA_BLOCK_LEN];
+#endif
+
+#if MODE == MODE_TONES
+const uint32_t _tone_freqs[] = TONE_FREQS;
+uint16_t _tone_block[ADC_DMA_BLOCK_LEN];
+uint32_t _tone_count;
+#elif MODE == MODE_SDFT
+const uint16_t _sdft_bins[] = SDFT_BINS;
+int16_t  _sdft_hist[1 << SDFT_LEN_SHIFT];
+uint16_t _sdft_block[ADC_DMA_BLOCK_LEN];
+uint32_t _sdft_blocks;
+#elif MODE == MODE_FILTER
+uint32_t _filter_response[FILTER_FFT_LEN / 2 + 1];
+int16_t  _filter_overlap[FILTER_HOP];
+uint32_t _filter_count;
+#endif
+
+#if MODE == MODE_FFT
+/*
+ * Frames are copied from a history of decimated, filtered
+ * samples, sampling continues meanwhile. They follow each
+ * other, or overlap with Welch averaging.
+ */
+int16_t _frame_hist[SAMPLE_BUF_LEN];
+size_t  _frame_pos;  // Next sample written
+size_t  _frame_new;  // Samples since the last frame
+#endif
+
+#if MODE == MODE_EVENT
+volatile uint8_t  _event_pending;
+volatile size_t   _event_pos;
+volatile uint64_t _event_clock;
+uint32_t          _event_count;
+#endif
+
+/*
+ * Housekeeping: Vrefint and the temperature sensor are sampled
+ * once per frame as injected conversions, triggered by TIM2 CC1
+ * in the gap after a regular conversion. They feed a running
+ * calibration of the ADC scale. The offset is tracked by the
+ * DC filter in the conditioning pass.
+ *
+ * The scale multiplies the fixed ADC_GAIN as well as the AGC
+ * gain. The AGC is fed the scaled peak, so its gain refers
+ * to samples normalized to 3.3 V. Event mode sends raw
+ * samples and only reports VDDA and the temperature.
+ */
+#define VREFINT_MV      1200
+#define VREFINT_NOMINAL ((VREFINT_MV * 4096) / 3300) // Counts @ 3.3 V
+
+#define TEMP_V25_MV     1430
+#define TEMP_SLOPE_UV   4300 // per degree C
+
+// Start the injected pair after the regular conversion
+#define ADC_INJECTED_DELAY (ADC_CONV_CYCLES(ADC_SAMPLE_CYCLES_X2) + ADC_CAL_GAP)
+
+// Running averages have 4 fractional bits, new values weigh 1/8
+#define CAL_AVG_SHIFT 3
+
+uint32_t _cal_vref   = VREFINT_NOMINAL << 4;
+uint32_t _cal_temp   = 0;
+
+// Q15 scale correction, normalizes samples to a 3.3 V reference
+uint32_t _cal_scale  = 1 << 15;
+
+dc_filter_t _dc_filter;
+biquad_t    _adc_filter;
+
+/*
+ * Frames are copied into the real part (low half word) of
+ * the complex FFT input and processed in place. For the
+ * real FFT they fill both half words in order. In event
+ * mode this is the ring buffer of raw samples.
+ */
+uint32_t _fft_data[FFT_LEN];
+uint32_t _fft_result[FFT_LEN];
+
+/*
+ * Current FFT length and samples per frame, selected
+ * with the "fft <len>" command in FFT mode.
+ */
+size_t _fft_len   = FFT_LEN;
+size_t _frame_len = SAMPLE_BUF_LEN;
+
+#if FFT_WELCH
+size_t _frame_hop = SAMPLE_BUF_LEN / FFT_WELCH_HOP_DIV;
+#else
+size_t _frame_hop = SAMPLE_BUF_LEN;
+#endif
+
+/*
+ * Window from the generated tables, selected with the
+ * "window <name>" command.
+ */
+#define FFT_WINDOW WINDOW_HANN
+
+const int16_t* _fft_window = NULL;
+
+/*
+ * Spectrum output:
+ *  - LINEAR: Magnitude as selected by FFT_MAGNITUDE
+ *  - DB16: Power in 1/256 dB relative to one LSB
+ *  - DB8: Power in 1/2 dB relative to one LSB, 0 .. 186
+ */
+#define FFT_OUTPUT_LINEAR 0
+#define FFT_OUTPUT_DB16   1
+#define FFT_OUTPUT_DB8    2
+
+#define FFT_OUTPUT FFT_OUTPUT_DB8
+// #define FFT_OUTPUT FFT_OUTPUT_DB16
+// #define FFT_OUTPUT FFT_OUTPUT_LINEAR
+
+/*
+ * Band aggregation: Send the energy of FFT_BAND_SCALE
+ * bands instead of all bins.
+ */
+#define FFT_BANDS 1
+#define FFT_BAND_SCALE BANDS_MEL
+// #define FFT_BAND_SCALE BANDS_THIRD_OCTAVE
+// #define FFT_BAND_SCALE BANDS_LINEAR
+
+// See magnitude.h for the error of each method
+#if FFT_OUTPUT == FFT_OUTPUT_LINEAR && !FFT_BANDS && !FFT_WELCH
+#define FFT_MAGNITUDE MAGNITUDE_NEWTON
+// #define FFT_MAGNITUDE MAGNITUDE_ABACUS
+// #define FFT_MAGNITUDE MAGNITUDE_POWER
+// #define FFT_MAGNITUDE MAGNITUDE_ALPHA_BETA
+#else
+#define FFT_MAGNITUDE MAGNITUDE_POWER
+#endif
+
+/*
+ * Spectrum view: The instant spectrum, a moving average
+ * over about 1 << FFT_ACCUM_AVG_SHIFT frames or the decaying
+ * peak. Selected with the "view <instant|average|peak>"
+ * command, only every FFT_OUTPUT_EVERY-th frame is sent.
+ */
+#define FFT_ACCUM 1
+#define FFT_ACCUM_VIEW        ACCUM_AVERAGE
+#define FFT_ACCUM_AVG_SHIFT   3
+#define FFT_ACCUM_DECAY_SHIFT 4
+
+#define FFT_OUTPUT_EVERY 1
+
+// Values per frame after magnitude and band aggregation
+#if FFT_BANDS
+#define FFT_OUT_MAX BANDS_MAX
+#else
+#define FFT_OUT_MAX FFT_LEN
+#endif
+
+#if FFT_WELCH
+uint32_t _welch_acc[FFT_OUT_MAX];
+#endif
+
+#if FFT_ACCUM
+uint32_t _accum_avg[FFT_OUT_MAX];
+uint32_t _accum_peak[FFT_OUT_MAX];
+uint8_t  _accum_view = FFT_ACCUM_VIEW;
+#endif
+
+uint32_t _output_skipped;
+
+
+#if BENCH
+/*
+ * Time all magnitude methods on a copy of the spectrum,
+ * in the order of the MAGNITUDE_ constants. The FFT input
+ * is free by now and used as scratch.
+ */
+void magnitude_bench(const uint32_t* spectrum, size_t len)
 {
-    for (size_t i = 0; i < len; i++) {
-        int16_t rl = C_REAL(values[i]);
-        int16_t im = C_IMAG(values[i]);
-        uint32_t mag = fast_sqrt(rl*rl + im*im);
-        values[i] = mag;
+    uint32_t cycles[MAGNITUDE_COUNT];
+
+    for (uint8_t m = 0; m < MAGNITUDE_COUNT; m++) {
+        memcpy(_fft_data, spectrum, len * sizeof(uint32_t));
+
+        uint32_t t0 = dwt_read_cycle_counter();
+        magnitude_apply(m, _fft_data, len);
+        uint32_t t1 = dwt_read_cycle_counter();
+
+        cycles[m] = t1 - t0;
+    }
+
+    printf("# cycles magnitude");
+    for (uint8_t m = 0; m < MAGNITUDE_COUNT; m++) {
+        printf(" %lu", cycles[m]);
     }
+    printf(" per bin");
+    for (uint8_t m = 0; m < MAGNITUDE_COUNT; m++) {
+        printf(" %lu", cycles[m] / len);
+    }
+    printf("\r\n");
 }
 
 
 /*
- * Precalculate hamming window weights, so we can just
- * multiply adc values with the window.
+ * Time condition_apply against separate passes for peak,
+ * gain, clipping and window, both on a copy of the frame
+ * before conditioning. The FFT output is free and used as
+ * scratch.
  */
-void fft_hamming_init(uint16_t* window, size_t len)
+void condition_bench(const uint32_t* frame,
+                     size_t step,
+                     size_t len,
+                     int32_t gain,
+                     uint8_t shift)
 {
-    for(size_t i = 0; i < SAMPLE_BUF_LEN; i++) {
-        window[i] = 0;
+#if FFT_PACKED
+    size_t stride = 1;
+    size_t n = 2 * len;
+#else
+    size_t stride = 2;
+    size_t n = len;
+#endif
+    int16_t* samples = (int16_t*)_fft_result;
+
+    memcpy(_fft_result, frame, len * sizeof(uint32_t));
+    uint32_t t0 = dwt_read_cycle_counter();
+#if FFT_PACKED
+    uint32_t peak = condition_apply_packed(_fft_result, _fft_window,
+                                           step, len, gain, shift);
+#else
+    uint32_t peak = condition_apply(_fft_result, _fft_window,
+                                    step, len, gain, shift);
+#endif
+    uint32_t t1 = dwt_read_cycle_counter();
+
+    memcpy(_fft_result, frame, len * sizeof(uint32_t));
+    uint32_t t2 = dwt_read_cycle_counter();
+
+    uint32_t peak_sep = 0;
+    for (size_t i = 0; i < n; i++) {
+        int32_t v = samples[i * stride];
+        uint32_t a = v < 0 ? -v : v;
+        if (a > peak_sep) {
+            peak_sep = a;
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        int32_t v = ((int64_t)samples[i * stride] * gain) >> shift;
+        if (v > INT16_MAX) {
+            v = INT16_MAX;
+        }
+        else if (v < INT16_MIN) {
+            v = INT16_MIN;
+        }
+        samples[i * stride] = v;
+    }
+    for (size_t i = 0; i < n; i++) {
+        int16_t weight = _fft_window[(i < n / 2 ? i : n - i) * step];
+        samples[i * stride] = (samples[i * stride] * weight) >> 15;
     }
 
+    uint32_t t3 = dwt_read_cycle_counter();
 
-    for(size_t i = 0; i < len; i++) {
-        window[i] = (0.53 - 0.46 * cos((2.0*M_PI*i) / (len-1))) * 65535;
+    printf("# cycles condition fused %lu separate %lu "
+           "per sample %lu %lu peak %lu %lu\r\n",
+           t1 - t0, t3 - t2, (t1 - t0) / n, (t3 - t2) / n,
+           peak, peak_sep);
+}
+
+
+/*
+ * Time the filter cascade on a copy of its state, with
+ * the frame as input.
+ */
+void biquad_bench(const uint32_t* samples, size_t len)
+{
+    biquad_t filter = _adc_filter;
+    int32_t sum = 0;
+
+    uint32_t t0 = dwt_read_cycle_counter();
+    for (size_t i = 0; i < len; i++) {
+        sum += biquad_step(&filter, (int16_t)samples[i]);
     }
+    uint32_t t1 = dwt_read_cycle_counter();
+
+    // Per section and sample, without sections the overhead
+    printf("# cycles biquad %lu sections %u per sample %lu %ld\r\n",
+           t1 - t0, filter.count,
+           (t1 - t0) / (len * (filter.count ? filter.count : 1)), sum);
 }
+#endif
 
-void fft_hamming_apply(uint32_t* values, uint16_t* window, size_t len)
+#if FFT_REF_CHECK
+/*
+ * Checksum of a transform result
+ */
+uint32_t fft_ref_sum(const uint32_t* data, size_t len)
 {
-    for(size_t i = 0; i < len; i++) {
-        values[i] = ((values[i] * window[i]) >> 16) & 0xffff;
+    uint32_t sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        sum = ((sum << 5) | (sum >> 27)) ^ data[i];
     }
+    return sum;
 }
 
 
-void adc_gain(uint16_t* values, size_t len, uint16_t gain)
+/*
+ * Transform noise with both FFT versions, the results
+ * should be identical. There is no room for a third
+ * buffer, so only their checksums are compared.
+ */
+void fft_ref_check()
 {
-    // gain 0, 100, 255, .. -> 0.0, 1.0, 2.55, ..
-    for(size_t i = 0; i < len; i++) {
-        int32_t v = 2048 + \
-            ((((int32_t)values[i] - 2048) * (int32_t)gain) / 100);
-        // clipping
-        if (v > 4096) {
-            v = 4096;
-        }
-        else if (v < 0) {
-            v = 0;
+    for (size_t len = 64; len <= FFT_LEN; len *= 4) {
+        uint32_t seed = 1;
+        for (size_t i = 0; i < len; i++) {
+            seed = seed * 1664525 + 1013904223;
+            _fft_data[i] = seed;
         }
-        values[i] = (uint16_t)v;
+
+        fft_transform(_fft_result, _fft_data, len);
+        uint32_t sum_asm = fft_ref_sum(_fft_result, len);
+
+        cr4_fft_ref(_fft_result, _fft_data, len);
+        uint32_t sum_ref = fft_ref_sum(_fft_result, len);
+
+        printf("# fft check %u asm %08lx ref %08lx %s\r\n",
+               len, sum_asm, sum_ref,
+               sum_asm == sum_ref ? "ok" : "MISMATCH");
     }
 }
+#endif
+
+/*
+ * Update the running calibration with a new pair
+ * of Vrefint and temperature sensor readings.
+ */
+void adc_cal_update(uint16_t vref, uint16_t temp)
+{
+    if (_cal_temp == 0) {
+        _cal_temp = (uint32_t)temp << 4;
+    }
+
+    _cal_vref += (int32_t)(((uint32_t)vref << 4) - _cal_vref) >> CAL_AVG_SHIFT;
+    _cal_temp += (int32_t)(((uint32_t)temp << 4) - _cal_temp) >> CAL_AVG_SHIFT;
+
+    // A low Vrefint reading means a high VDDA and vice versa.
+    _cal_scale = ((uint32_t)VREFINT_NOMINAL << (15 + 4)) / _cal_vref;
+}
+
+/*
+ * Calculate the supply voltage in mV from Vrefint
+ */
+uint32_t adc_cal_vdda()
+{
+    return ((VREFINT_MV * 4096) << 4) / _cal_vref;
+}
+
+/*
+ * Calculate the chip temperature in 1/10 degree C
+ */
+int32_t adc_cal_temperature()
+{
+    int32_t vsense = ((_cal_temp >> 4) * adc_cal_vdda()) / 4096;
+    return 250 + ((TEMP_V25_MV - vsense) * 10000) / TEMP_SLOPE_UV;
+}
+
+/*
+ * Sample the housekeeping channels once, on the next
+ * TIM2 CC1 event.
+ */
+void adc_cal_trigger()
+{
+#if ADC_CAL
+    ADC_CR2(ADC1) |= ADC_CR2_JEXTTRIG;
+#endif
+}
 
 void adc_gpio_init()
 {
@@ -111,27 +785,24 @@ void adc_timer_init()
 
     timer_set_prescaler(TIM2, 0);
 
-    // 72 MHz clock, 40 kHz sampling freq,
-    // 1800 cycles
-    timer_set_period(TIM2, 1800);
-    timer_set_oc_value(TIM2, TIM_OC2, 1800);
+    // Trigger a conversion every ADC_TIMER_PERIOD cycles
+    timer_set_period(TIM2, ADC_TIMER_PERIOD);
+    timer_set_oc_value(TIM2, TIM_OC2, ADC_TIMER_PERIOD);
 
-    // Try 30 kHz
-    // timer_set_period(TIM2, 2400);
-    // timer_set_oc_value(TIM2, TIM_OC2, 2400);
-
-    // Try 20 kHz
-    // timer_set_period(TIM2, 3600);
-    // timer_set_oc_value(TIM2, TIM_OC2, 3600);
-
-    // Try 6 kHz
-    // timer_set_period(TIM2, 12000);
-    // timer_set_oc_value(TIM2, TIM_OC2, 12000);
+    // Clock the sample counter
+    timer_set_master_mode(TIM2, TIM_CR2_MMS_UPDATE);
 
     // Enable output compare event
     timer_set_oc_mode(TIM2,  TIM_OC2, TIM_OCM_PWM1);
     timer_disable_oc_clear(TIM2, TIM_OC2);
     timer_enable_oc_output(TIM2, TIM_OC2);
+
+    // Injected conversions are triggered after the
+    // regular conversion finished.
+    timer_set_oc_value(TIM2, TIM_OC1, ADC_INJECTED_DELAY);
+    timer_set_oc_mode(TIM2,  TIM_OC1, TIM_OCM_PWM1);
+    timer_disable_oc_clear(TIM2, TIM_OC1);
+    timer_enable_oc_output(TIM2, TIM_OC1);
 }
 
 
@@ -141,6 +812,56 @@ void adc_timer_start()
 }
 
 
+/*
+ * Count conversions with TIM3, clocked by TIM2
+ */
+void adc_clock_init()
+{
+    rcc_periph_clock_enable(RCC_TIM3);
+    timer_reset(TIM3);
+
+    timer_set_period(TIM3, 0xffff);
+
+    // External clock mode 1 on ITR1 (TIM2 TRGO)
+    timer_slave_set_trigger(TIM3, TIM_SMCR_TS_ITR1);
+    timer_slave_set_mode(TIM3, TIM_SMCR_SMS_ECM1);
+
+    // Extend on overflow
+    timer_enable_irq(TIM3, TIM_DIER_UIE);
+    nvic_enable_irq(NVIC_TIM3_IRQ);
+
+    timer_enable_counter(TIM3);
+}
+
+
+void tim3_isr()
+{
+    TIM3_SR &= ~TIM_SR_UIF; // Clear flag
+    _clock_hi++;
+}
+
+
+/*
+ * Get the number of conversions since start
+ */
+uint64_t adc_clock()
+{
+    uint32_t hi, lo;
+
+    CM_ATOMIC_BLOCK() {
+        hi = _clock_hi;
+        lo = TIM3_CNT;
+
+        // We might be in an interrupt blocking the overflow
+        if ((TIM3_SR & TIM_SR_UIF) && lo < 0x8000) {
+            hi++;
+        }
+    }
+
+    return ((uint64_t)hi << 16) | lo;
+}
+
+
 /*
  * Initialize single ADC triggered by TIM1 for a
  * fixed sampling rate of 4 kHz
@@ -152,19 +873,31 @@ void adc_init()
 
     // Setup trigger timer
     adc_timer_init();
+    adc_clock_init();
 
     // Configure ADC1
     rcc_periph_clock_enable(RCC_ADC1);
 
+    // ADC_CLOCK, the conversion timing depends on it
+    rcc_set_adcpre(RCC_CFGR_ADCPRE_PCLK2_DIV6);
+
     // ADC should not run during configuration
     adc_power_off(ADC1);
 
-    // Configure ADCs
-    adc_disable_scan_mode(ADC1);
+    // Configure ADCs: Scan mode is required for
+    // the injected sequence.
+    adc_enable_scan_mode(ADC1);
     adc_set_right_aligned(ADC1);
 
     // adc_set_sample_time_on_all_channels(ADC1, ADC_SMPR_SMP_1DOT5CYC);
-    adc_set_sample_time_on_all_channels(ADC1, ADC_SMPR_SMP_55DOT5CYC);
+    adc_set_sample_time_on_all_channels(ADC1, ADC_SAMPLE_TIME);
+
+    // The internal channels need a longer sampling time.
+    // (The datasheet asks for 17.1 us for the temperature
+    // sensor, which does not fit between two regular
+    // conversions at 40 kHz; it only drifts slowly anyway.)
+    adc_set_sample_time(ADC1, ADC_CHANNEL_TEMP, ADC_SMPR_SMP_71DOT5CYC);
+    adc_set_sample_time(ADC1, ADC_CHANNEL_VREF, ADC_SMPR_SMP_71DOT5CYC);
 
     // Single conversion on external trigger
     adc_enable_external_trigger_regular(ADC1, ADC_CR2_EXTSEL_TIM2_CC2);
@@ -174,6 +907,30 @@ void adc_init()
     uint8_t channels[] = {0,};
     adc_set_regular_sequence(ADC1, 1, channels);
 
+#if MODE == MODE_EVENT
+    // Interrupt when the signal leaves the window
+    adc_set_watchdog_high_threshold(ADC1, EVENT_THRESHOLD_HIGH);
+    adc_set_watchdog_low_threshold(ADC1, EVENT_THRESHOLD_LOW);
+    adc_enable_analog_watchdog_on_selected_channel(ADC1, 0);
+    adc_enable_analog_watchdog_regular(ADC1);
+    adc_enable_awd_interrupt(ADC1);
+#endif
+
+#if ADC_CAL
+    // Housekeeping channels
+    uint8_t injected[] = {ADC_CHANNEL_VREF, ADC_CHANNEL_TEMP};
+    adc_set_injected_sequence(ADC1, 2, injected);
+
+    // Enable temperature sensor and Vrefint
+    ADC_CR2(ADC1) |= ADC_CR2_TSVREFE;
+
+    // Injected conversions on TIM2 CC1, the trigger
+    // is armed once per frame.
+    adc_enable_external_trigger_injected(ADC1, ADC_CR2_JEXTSEL_TIM2_CC1);
+    adc_enable_eoc_interrupt_injected(ADC1);
+#endif
+    nvic_enable_irq(NVIC_ADC1_2_IRQ);
+
     // Enable DMA
     adc_enable_dma(ADC1);
 
@@ -203,13 +960,30 @@ void dma_init()
     dma_disable_channel(DMA1, DMA_CHANNEL1);
 
     // Set source and dst address
-    dma_set_memory_address(DMA1, DMA_CHANNEL1,     (uint32_t)&_adc_samples);
+#if ADC_STREAM
+    dma_set_memory_address(DMA1, DMA_CHANNEL1,     (uint32_t)&_adc_dma_buf);
+#else
+    dma_set_memory_address(DMA1, DMA_CHANNEL1,     (uint32_t)&_fft_data);
+#endif
     dma_set_peripheral_address(DMA1, DMA_CHANNEL1, (uint32_t)&ADC1_DR);
 
     // Setup DMA2 controller:
     // We transfer from peripheral ADC1, a single half word
     dma_set_peripheral_size(DMA1, DMA_CHANNEL1, DMA_CCR_PSIZE_16BIT);
+#if ADC_STREAM
+    /*
+     * Raw half words into the double buffer: Every sample
+     * is decimated first, for FFT frames also filtered, so
+     * the DMA can not write the FFT input in place. frame_copy
+     * lays out the real or complex frame, only event mode
+     * still has the DMA widen the samples.
+     */
     dma_set_memory_size(DMA1, DMA_CHANNEL1, DMA_CCR_MSIZE_16BIT);
+#else
+    // ... and write a word: The sample is zero extended
+    // to a complex value with imaginary part 0.
+    dma_set_memory_size(DMA1, DMA_CHANNEL1, DMA_CCR_MSIZE_32BIT);
+#endif
 
     // We read into mem
     dma_set_read_from_peripheral(DMA1, DMA_CHANNEL1);
@@ -217,81 +991,675 @@ void dma_init()
     // Increment addr
     dma_enable_memory_increment_mode(DMA1, DMA_CHANNEL1);
 
+#if ADC_STREAM
+    // Stream into the double buffer, we get notified
+    // when either half is filled.
+    dma_enable_circular_mode(DMA1, DMA_CHANNEL1);
+    dma_enable_half_transfer_interrupt(DMA1, DMA_CHANNEL1);
+    dma_enable_transfer_error_interrupt(DMA1, DMA_CHANNEL1);
+#elif MODE == MODE_EVENT
+    // Run continuously, only the analog watchdog
+    // wakes us up.
+    dma_enable_circular_mode(DMA1, DMA_CHANNEL1);
+#endif
+
+#if MODE != MODE_EVENT
     // Enable IRQ
     nvic_enable_irq(NVIC_DMA1_CHANNEL1_IRQ);
     dma_enable_transfer_complete_interrupt(DMA1, DMA_CHANNEL1);
+#endif
+}
+
+
+/*
+ * Get the index of the next sample written by the DMA
+ */
+size_t adc_dma_pos()
+{
+    return ADC_DMA_LEN - DMA_CNDTR(DMA1, DMA_CHANNEL1);
 }
 
 
 void adc_dma_transfer_start()
 {
-    dma_set_number_of_data(DMA1, DMA_CHANNEL1, FFT_LEN);
+    _adc_samples_len = 0;
+
+    dma_set_number_of_data(DMA1, DMA_CHANNEL1, ADC_DMA_LEN);
     dma_enable_channel(DMA1, DMA_CHANNEL1);
 }
 
 
-void dma1_channel1_isr()
+/*
+ * Decimate a block of raw samples: Sum up ADC_OVERSAMPLE
+ * samples and shift out the excess bits, or run the FIR.
+ * The result has ADC_SAMPLE_BITS bits and is written to
+ * every stride-th half word of out.
+ *
+ * Returns the number of decimated samples.
+ */
+size_t adc_decimate(uint16_t* out, size_t stride,
+                    const uint16_t* block, size_t len)
 {
-    // Check Transfer complete interrupt flag
-    if (dma_get_interrupt_flag(DMA1, DMA_CHANNEL1, DMA_TCIF)) {
-        dma_disable_channel(DMA1, DMA_CHANNEL1);
+#if ADC_DECIMATOR == ADC_DECIMATOR_FIR
+    return fir_decimate(out, stride, block, len);
+#else
+    size_t n = 0;
+    for (size_t i = 0; i + ADC_OVERSAMPLE <= len; i += ADC_OVERSAMPLE) {
+        uint32_t acc = 0;
+        for (size_t j = 0; j < ADC_OVERSAMPLE; j++) {
+            acc += block[i + j];
+        }
+        out[stride * n++] = acc >> ADC_OVERSAMPLE_BITS;
+    }
 
-        // Add gain to signal
-        adc_gain(_adc_samples, SAMPLE_BUF_LEN, 150);
+    return n;
+#endif
+}
 
-        // Fill buffer
-        for(uint16_t i = 0; i < SAMPLE_BUF_LEN; i++) {
-            // remap [0.0, 0.5, 1.0] represented as [0, 2048, 4096]
-            // to [0, 65535] -> floor(65535 / 2048)
-            _fft_data[i] = (15 * _adc_samples[i % FFT_LEN]) & 0xffff;
-        }
 
-        // FFT
-        fft_hamming_apply(_fft_data, _fft_window, 1024);
-        cr4_fft_1024_stm32((void*)_fft_result, (void*)_fft_data, 1024);
+/*
+ * Get the timestamp of the first sample of the current frame
+ * and count the frames lost since the last one, while we
+ * were busy.
+ */
+uint64_t frame_timestamp()
+{
+    uint64_t start = _frame_clock / ADC_OVERSAMPLE - _frame_len;
+    if (_frame_count > 0 && start > _frame_next) {
+        _frame_dropped += (start - _frame_next) / _frame_hop;
+    }
+    _frame_next = start + _frame_hop;
+    _frame_count++;
+
+    return start;
+}
+
+
+void frame_info_print(uint64_t start, int32_t gain, uint32_t level)
+{
+    printf("# frame %lu ts %llu dropped %lu overruns %lu %lu\r\n",
+           _frame_count, start, _frame_dropped,
+           _dma_overruns, usb_serial_tx_dropped());
+
+    // The applied gain in percent
+    printf("# vdda %lu temp %ld gain %ld level %lu\r\n",
+           adc_cal_vdda(), adc_cal_temperature(),
+           (int32_t)(((int64_t)gain * 100) >> 15), level);
+}
+
 
-        fft_magnitude(_fft_result, FFT_LEN/2);
-        for (int i = 0; i < FFT_LEN/2; i++) {
-            printf("%d %lu\r\n", i, _fft_result[i]);
+/*
+ * Process a full frame of samples: Apply gain, window
+ * and calculate the spectrum.
+ */
+void frame_process()
+{
+    // Sample housekeeping channels once per frame
+    adc_cal_trigger();
+
+    // The offset is removed and the samples are filtered
+    // already. Add gain normalized to 3.3 V, scale and apply
+    // the window in one go.
+#if ADC_AGC
+    int32_t gain = ((int64_t)agc_gain() * _cal_scale) >> 15;
+#else
+    int32_t gain = (ADC_GAIN * _cal_scale) / 100;
+#endif
+
+#if BENCH
+    condition_bench(_fft_data, WINDOW_LEN / _frame_len, _fft_len,
+                    gain, ADC_GAIN_SHIFT);
+    uint32_t t0 = dwt_read_cycle_counter();
+#endif
+
+#if FFT_PACKED
+    uint32_t peak = condition_apply_packed(_fft_data, _fft_window,
+                                           WINDOW_LEN / _frame_len, _fft_len,
+                                           gain, ADC_GAIN_SHIFT);
+#else
+    uint32_t peak = condition_apply(_fft_data, _fft_window,
+                                    WINDOW_LEN / _frame_len, _fft_len,
+                                    gain, ADC_GAIN_SHIFT);
+#endif
+#if ADC_AGC
+    agc_update(((uint64_t)peak * _cal_scale) >> 15, ADC_GAIN_SHIFT);
+#endif
+
+    uint64_t start = frame_timestamp();
+
+#if ADC_GATE
+    // Skip quiet frames entirely
+    uint8_t gate = gate_update(peak);
+    if (gate != GATE_OPEN) {
+        if (gate == GATE_HEARTBEAT) {
+            frame_info_print(start, gain, peak);
         }
+        return;
+    }
+#endif
+
+#if BENCH
+    uint32_t t1 = dwt_read_cycle_counter();
+#endif
+
+    // FFT
+    fft_transform(_fft_result, _fft_data, _fft_len);
+#if FFT_PACKED
+    rfft_split(_fft_result, _fft_len);
+#endif
+
+#if BENCH
+    uint32_t t2 = dwt_read_cycle_counter();
+    biquad_bench(_fft_data, _fft_len);
+    magnitude_bench(_fft_result, _frame_len / 2);
+    uint32_t t2_bench = dwt_read_cycle_counter();
+#endif
+
+    uint32_t* out = _fft_result;
+    size_t out_len = _frame_len / 2;
+
+    magnitude_apply(FFT_MAGNITUDE, out, out_len);
+#if FFT_BANDS
+    // Band energies, the FFT input is free
+    out_len = bands_apply(out, _fft_data);
+    out = _fft_data;
+#endif
+
+#if FFT_WELCH
+    if (!welch_accumulate(out, out_len)) {
+        return;
+    }
+#endif
 
-        /*
-        uint16_t max = 0;
-        uint32_t avg = 0;
-
-        for(uint16_t i = 0; i < SAMPLE_BUF_LEN; i++) {
-            if (max < _adc_samples[i]) {
-                max = _adc_samples[i];
-            }
-            avg += _adc_samples[i];
+#if FFT_ACCUM
+    accum_update(out, out_len, _accum_view);
+#endif
+
+    if (++_output_skipped < FFT_OUTPUT_EVERY) {
+        return;
+    }
+    _output_skipped = 0;
+
+#if FFT_OUTPUT == FFT_OUTPUT_DB16
+    db_apply(out, out_len, 0);
+#elif FFT_OUTPUT == FFT_OUTPUT_DB8
+    db_apply(out, out_len, 7);
+#endif
+
+#if BENCH
+    uint32_t t3 = dwt_read_cycle_counter();
+    printf("# cycles condition %lu fft %lu magnitude %lu\r\n",
+           t1 - t0, t2 - t1, t3 - t2_bench);
+#endif
+
+    frame_info_print(start, gain, peak);
+    for (size_t i = 0; i < out_len; i++) {
+        printf("%u %lu\r\n", i, out[i]);
+    }
+
+    /*
+    uint16_t max = 0;
+    uint32_t avg = 0;
+
+    for(uint16_t i = 0; i < SAMPLE_BUF_LEN; i++) {
+        if (max < _fft_data[i]) {
+            max = _fft_data[i];
         }
-        avg /= SAMPLE_BUF_LEN;
-        printf("%d %d\r\n", max, max - avg);
-        */
+        avg += _fft_data[i];
+    }
+    avg /= SAMPLE_BUF_LEN;
+    printf("%d %d\r\n", max, max - avg);
+    */
 
 
-        /*
-        // Just printout the samples
-        for (int i = 0; i < 1024; i++) {
-            printf("%d %d\r\n", i, _adc_samples[i]);
+    /*
+    // Just printout the samples
+    for (int i = 0; i < 1024; i++) {
+        printf("%d %lu\r\n", i, _fft_data[i]);
+    }
+    */
+}
+
+
+#if ADC_STREAM
+#if MODE == MODE_FFT
+/*
+ * Copy the latest frame from the history into the FFT
+ * input: Into the real parts, or packed for the real FFT.
+ */
+void frame_copy()
+{
+    int16_t* out = (int16_t*)_fft_data;
+    size_t stride = FFT_PACKED ? 1 : 2;
+    size_t pos = (_frame_pos + SAMPLE_BUF_LEN - _frame_len) % SAMPLE_BUF_LEN;
+
+    for (size_t i = 0; i < _frame_len; i++) {
+        out[stride * i] = _frame_hist[pos];
+        pos = (pos + 1) % SAMPLE_BUF_LEN;
+    }
+}
+#endif
+
+
+/*
+ * Print the captured scope window and wait for
+ * the next trigger. start is the timestamp of its
+ * first sample.
+ */
+void scope_process(uint64_t start)
+{
+    printf("# trigger %d ts %llu\r\n", SCOPE_PRE_TRIGGER, start);
+    for (size_t i = 0; i < scope_window_len(); i++) {
+        printf("%d %d\r\n", i, scope_window_sample(i));
+    }
+
+    scope_arm();
+}
+
+
+#if MODE == MODE_TONES
+/*
+ * Print the tone amplitudes of the completed block,
+ * in ADC steps. The timestamp of its first sample is
+ * accurate to one DMA block.
+ */
+void tones_process(uint64_t end)
+{
+    // Sample housekeeping channels once per block
+    adc_cal_trigger();
+
+    _tone_count++;
+    printf("# tones %lu ts %llu overruns %lu %lu\r\n",
+           _tone_count, end - (1 << TONE_LEN_SHIFT),
+           _dma_overruns, usb_serial_tx_dropped());
+    for (size_t i = 0; i < goertzel_count(); i++) {
+        printf("%lu %lu\r\n", _tone_freqs[i], goertzel_amplitude(i));
+    }
+}
+#endif
+
+
+#if MODE == MODE_SDFT
+/*
+ * Report the bins switched on or off within the block
+ * starting at sample start, then every
+ * SDFT_REPORT_EVERY blocks all amplitudes.
+ */
+void sdft_process(uint32_t switched, uint64_t start)
+{
+    for (size_t i = 0; i < sdft_count(); i++) {
+        if (switched & (1 << i)) {
+            printf("# bin %u %s ts %llu\r\n", _sdft_bins[i],
+                   sdft_on(i) ? "on" : "off",
+                   start + sdft_switch_pos(i));
         }
-        */
+    }
+
+    if (++_sdft_blocks < SDFT_REPORT_EVERY) {
+        return;
+    }
+    _sdft_blocks = 0;
+
+    // Sample housekeeping channels once per report
+    adc_cal_trigger();
+
+    printf("# sdft ts %llu overruns %lu %lu\r\n",
+           start, _dma_overruns, usb_serial_tx_dropped());
+    for (size_t i = 0; i < sdft_count(); i++) {
+        printf("%lu %lu\r\n",
+               (_sdft_bins[i] * ADC_SAMPLE_RATE) >> SDFT_LEN_SHIFT,
+               sdft_amplitude(i));
+    }
+}
+#endif
+
+
+#if MODE == MODE_FILTER
+/*
+ * Filter the samples in the real parts of the FFT input
+ * and print them. start is the timestamp of the first
+ * input sample, the output is delayed by the FIR.
+ */
+void filter_process(uint64_t start)
+{
+    // Sample housekeeping channels once per block
+    adc_cal_trigger();
+
+    // Remove offset and scale, with one bit of headroom
+    for (size_t i = 0; i < FILTER_HOP; i++) {
+        int32_t v = dc_filter_step(&_dc_filter, _fft_data[i] & 0xffff);
+        _fft_data[i] = (uint16_t)(v << (15 - ADC_SAMPLE_BITS));
+    }
+
+    ola_apply(_fft_data, _fft_result);
+
+    _filter_count++;
+    printf("# filter %lu ts %llu overruns %lu %lu\r\n",
+           _filter_count, start,
+           _dma_overruns, usb_serial_tx_dropped());
+    for (size_t i = 0; i < FILTER_HOP; i++) {
+        printf("%u %d\r\n", i, (int16_t)_fft_data[i]);
+    }
+}
+#endif
+
+
+/*
+ * Handle a filled half of the DMA buffer: Decimate
+ * and process a frame or scope window when complete.
+ */
+void adc_stream_block(const uint16_t* block)
+{
+    // Conversions transferred after the block. The buffer
+    // length is not a power of 2 for every FIR factor, so
+    // the difference must not wrap.
+    size_t end = (block - _adc_dma_buf + ADC_DMA_BLOCK_LEN) % ADC_DMA_LEN;
+    size_t ahead = (adc_dma_pos() + ADC_DMA_LEN - end) % ADC_DMA_LEN;
+
+#if MODE == MODE_SCOPE
+    // The trigger is evaluated for every sample
+    size_t n = adc_decimate(_adc_block, 1, block, ADC_DMA_BLOCK_LEN);
+    if (!scope_feed(_adc_block, n)) {
+        return;
+    }
+#elif MODE == MODE_TONES
+    // The filters run on every sample, sampling continues
+    size_t n = adc_decimate(_tone_block, 1, block, ADC_DMA_BLOCK_LEN);
+    if (goertzel_feed(_tone_block, n, &_dc_filter)) {
+        tones_process((adc_clock() - ahead) / ADC_OVERSAMPLE);
+    }
+    return;
+#elif MODE == MODE_SDFT
+    // Every bin is updated with every sample
+    size_t n = adc_decimate(_sdft_block, 1, block, ADC_DMA_BLOCK_LEN);
+    uint32_t switched = sdft_feed(_sdft_block, n, &_dc_filter);
+    sdft_process(switched, (adc_clock() - ahead) / ADC_OVERSAMPLE - n);
+    return;
+#elif MODE == MODE_FILTER
+    // Collect a block in the real parts, sampling continues
+    _adc_samples_len += adc_decimate((uint16_t*)_fft_data +
+                                     2 * _adc_samples_len, 2,
+                                     block, ADC_DMA_BLOCK_LEN);
+    if (_adc_samples_len < FILTER_HOP) {
+        return;
+    }
+    _adc_samples_len = 0;
+
+    filter_process((adc_clock() - ahead) / ADC_OVERSAMPLE - FILTER_HOP);
+    return;
+#elif MODE == MODE_FFT
+    // Offset and filter state carry from block to block,
+    // the filter sees the continuous stream.
+    size_t n = adc_decimate(_adc_block, 1, block, ADC_DMA_BLOCK_LEN);
+    for (size_t i = 0; i < n; i++) {
+        _frame_hist[_frame_pos] = condition_filter(_adc_block[i],
+                                                   &_dc_filter,
+                                                   &_adc_filter);
+        _frame_pos = (_frame_pos + 1) % SAMPLE_BUF_LEN;
+    }
+    _frame_new += n;
+    if (_adc_samples_len < SAMPLE_BUF_LEN) {
+        _adc_samples_len += n;
+    }
+    if (_adc_samples_len < _frame_len || _frame_new < _frame_hop) {
+        return;
+    }
+    _frame_new = 0;
+
+    // Sampling continues, process a copy of the latest frame.
+    // Taking longer than a DMA block counts as overrun and
+    // leaves a gap in the stream.
+    _frame_clock = adc_clock() - ahead;
+    frame_copy();
+    frame_process();
+    return;
+#endif
+
+    // Stop sampling while we are busy
+    dma_disable_channel(DMA1, DMA_CHANNEL1);
+    _frame_clock = adc_clock() - ahead;
+
+    scope_process(_frame_clock / ADC_OVERSAMPLE -
+                  scope_unused() - scope_window_len());
 
+    dma_clear_interrupt_flags(DMA1, DMA_CHANNEL1, DMA_HTIF | DMA_TCIF);
+    adc_dma_transfer_start();
+}
+
+
+void dma1_channel1_isr()
+{
+    // Both halves are filled: We were too slow and the
+    // DMA already started to overwrite the first one.
+    if (dma_get_interrupt_flag(DMA1, DMA_CHANNEL1, DMA_HTIF) &&
+        dma_get_interrupt_flag(DMA1, DMA_CHANNEL1, DMA_TCIF)) {
+        _dma_overruns++;
+    }
+
+    if (dma_get_interrupt_flag(DMA1, DMA_CHANNEL1, DMA_TEIF)) {
+        dma_clear_interrupt_flags(DMA1, DMA_CHANNEL1, DMA_TEIF);
+        _dma_overruns++;
+    }
 
-        // Clear transfer complete.
+    // First half of the buffer is filled
+    if (dma_get_interrupt_flag(DMA1, DMA_CHANNEL1, DMA_HTIF)) {
+        dma_clear_interrupt_flags(DMA1, DMA_CHANNEL1, DMA_HTIF);
+        adc_stream_block(_adc_dma_buf);
+    }
+
+    // Second half of the buffer is filled
+    if (dma_get_interrupt_flag(DMA1, DMA_CHANNEL1, DMA_TCIF)) {
         dma_clear_interrupt_flags(DMA1, DMA_CHANNEL1, DMA_TCIF);
+        adc_stream_block(_adc_dma_buf + ADC_DMA_BLOCK_LEN);
+    }
+}
+
+#endif
 
-        // Enable Transfer
-        adc_dma_transfer_start();
+
+#if MODE == MODE_FFT
+/*
+ * Change the FFT length. Sampling is stopped and
+ * restarted with a new frame.
+ */
+void frame_set_len(size_t len)
+{
+    if (!fft_len_supported(len)) {
+        printf("# error fft length %u not supported\r\n", len);
+        return;
     }
+
+    nvic_disable_irq(NVIC_DMA1_CHANNEL1_IRQ);
+    dma_disable_channel(DMA1, DMA_CHANNEL1);
+
+    _fft_len = len;
+    _frame_len = len << FFT_PACKED;
+    _frame_pos = 0;
+    _frame_new = 0;
+#if FFT_WELCH
+    _frame_hop = _frame_len / FFT_WELCH_HOP_DIV;
+    welch_reset();
+#else
+    _frame_hop = _frame_len;
+#endif
+#if FFT_ACCUM
+    accum_reset();
+#endif
+#if FFT_BANDS
+    bands_init(FFT_BAND_SCALE, ADC_SAMPLE_RATE, _frame_len / 2);
+#endif
+
+    dma_clear_interrupt_flags(DMA1, DMA_CHANNEL1,
+                              DMA_HTIF | DMA_TCIF | DMA_TEIF);
+    printf("# fft %u frame %u\r\n", _fft_len, _frame_len);
+
+    adc_dma_transfer_start();
+    nvic_enable_irq(NVIC_DMA1_CHANNEL1_IRQ);
 }
 
 
+/*
+ * Select the window by name. Takes effect with the next
+ * frame, a pointer store is atomic.
+ */
+void frame_set_window(const char* name)
+{
+    for (size_t i = 0; i < WINDOW_COUNT; i++) {
+        if (strcmp(name, window_names[i]) == 0) {
+            _fft_window = window_tables[i];
+            printf("# window %s\r\n", window_names[i]);
+            return;
+        }
+    }
+
+    printf("# error unknown window %s\r\n", name);
+}
+
+
+/*
+ * Change the conditioning filter:
+ *
+ *   biquad clear
+ *   biquad <section> <b0> <b1> <b2> <a1> <a2>  (Q30)
+ *   notch <section> <freq>
+ */
+void filter_set(const char* line)
+{
+    uint8_t ok = 1;
+    char* end;
+
+    nvic_disable_irq(NVIC_DMA1_CHANNEL1_IRQ);
+
+    if (strcmp(line, "biquad clear") == 0) {
+        biquad_clear(&_adc_filter);
+    }
+    else if (strncmp(line, "biquad ", 7) == 0) {
+        int32_t c[5];
+        size_t i = strtoul(line + 7, &end, 10);
+        for (size_t k = 0; k < 5; k++) {
+            c[k] = strtol(end, &end, 10);
+        }
+        ok = biquad_set(&_adc_filter, i, c[0], c[1], c[2], c[3], c[4]);
+    }
+    else {
+        size_t i = strtoul(line + 6, &end, 10);
+        uint32_t freq = strtoul(end, NULL, 10);
+        ok = freq > 0 && freq < ADC_SAMPLE_RATE / 2 &&
+             biquad_set_notch(&_adc_filter, i, freq,
+                              ADC_SAMPLE_RATE, ADC_NOTCH_Q);
+    }
+
+    nvic_enable_irq(NVIC_DMA1_CHANNEL1_IRQ);
+
+    if (ok) {
+        printf("# filter sections %u\r\n", _adc_filter.count);
+    }
+    else {
+        printf("# error filter %s\r\n", line);
+    }
+}
+
+
+/*
+ * Handle a line received on the serial port
+ */
+void command_process(const char* line)
+{
+    if (strncmp(line, "fft ", 4) == 0) {
+        frame_set_len(strtoul(line + 4, NULL, 10));
+    }
+    else if (strncmp(line, "window ", 7) == 0) {
+        frame_set_window(line + 7);
+    }
+    else if (strncmp(line, "biquad ", 7) == 0 ||
+             strncmp(line, "notch ", 6) == 0) {
+        filter_set(line);
+    }
+#if FFT_ACCUM
+    else if (strcmp(line, "view instant") == 0) {
+        _accum_view = ACCUM_INSTANT;
+    }
+    else if (strcmp(line, "view average") == 0) {
+        _accum_view = ACCUM_AVERAGE;
+    }
+    else if (strcmp(line, "view peak") == 0) {
+        _accum_view = ACCUM_PEAK;
+    }
+#endif
+}
+#endif
+
+
+
+#if MODE == MODE_EVENT
+/*
+ * Report the burst around an event from the ring buffer
+ * and arm the watchdog again.
+ */
+void event_process()
+{
+    size_t start = (_event_pos - EVENT_PRE) % SAMPLE_BUF_LEN;
+
+    // Wait until the post-event samples are in
+    while ((adc_dma_pos() - _event_pos) % SAMPLE_BUF_LEN < EVENT_POST);
+
+    // Stop sampling while we are busy
+    dma_disable_channel(DMA1, DMA_CHANNEL1);
+
+    _event_count++;
+    printf("# event %lu ts %llu vdda %lu temp %ld\r\n",
+           _event_count, _event_clock,
+           adc_cal_vdda(), adc_cal_temperature());
+    for (size_t i = 0; i < EVENT_PRE + EVENT_POST; i++) {
+        printf("%d %lu\r\n", i, _fft_data[(start + i) % SAMPLE_BUF_LEN]);
+    }
+
+    adc_dma_transfer_start();
+
+    // Fill the pre-event part before arming again
+    while (adc_dma_pos() < EVENT_PRE);
+
+    _event_pending = 0;
+    ADC_SR(ADC1) &= ~ADC_SR_AWD;
+    adc_enable_awd_interrupt(ADC1);
+
+    // Sample housekeeping channels once per event
+    adc_cal_trigger();
+}
+#endif
+
+
+void adc1_2_isr()
+{
+#if MODE == MODE_EVENT
+    // Signal left the watchdog window
+    if (ADC_SR(ADC1) & ADC_SR_AWD) {
+        adc_disable_awd_interrupt(ADC1);
+        ADC_SR(ADC1) &= ~ADC_SR_AWD;
+
+        // The offending sample is the last one transferred
+        _event_pos = (adc_dma_pos() + SAMPLE_BUF_LEN - 1) % SAMPLE_BUF_LEN;
+        _event_clock = adc_clock() - 1;
+        _event_pending = 1;
+    }
+#endif
+
+    // Injected sequence complete
+    if (ADC_SR(ADC1) & ADC_SR_JEOC) {
+        // Disarm until the next frame
+        ADC_CR2(ADC1) &= ~ADC_CR2_JEXTTRIG;
+        ADC_SR(ADC1) &= ~(ADC_SR_JEOC | ADC_SR_JSTRT);
+
+        adc_cal_update(adc_read_injected(ADC1, 1),
+                       adc_read_injected(ADC1, 2));
+    }
+}
+
 
 int main(void)
 {
 	int i = 0;
-    // const char* line;
+    const char* line;
 
     // Clock Setup
     rcc_clock_setup_in_hse_8mhz_out_72mhz();
@@ -306,7 +1674,77 @@ int main(void)
     adc_init();
 
     // Init window
-    fft_hamming_init(_fft_window, 1024);
+    _fft_window = window_tables[FFT_WINDOW];
+#if FFT_BANDS
+    bands_init(FFT_BAND_SCALE, ADC_SAMPLE_RATE, _frame_len / 2);
+#endif
+
+    // Start tracking the offset from the midpoint
+    dc_filter_init(&_dc_filter, ADC_DC_SHIFT, ADC_SAMPLE_MID);
+
+#if ADC_DECIMATOR == ADC_DECIMATOR_FIR
+    fir_init(_fir_taps, _fir_hist, ADC_FIR_FACTOR, ADC_FIR_TAPS,
+             ADC_OVERSAMPLE_BITS);
+#endif
+
+    biquad_init(&_adc_filter);
+#if ADC_NOTCH_FREQ
+    biquad_set_notch(&_adc_filter, 0, ADC_NOTCH_FREQ,
+                     ADC_SAMPLE_RATE, ADC_NOTCH_Q);
+#endif
+
+#if ADC_AGC
+    agc_init(AGC_TARGET, AGC_ATTACK, AGC_RELEASE,
+             AGC_MIN_GAIN, AGC_MAX_GAIN);
+#endif
+
+#if FFT_WELCH
+    welch_init(_welch_acc, FFT_OUT_MAX, FFT_WELCH_FRAMES_SHIFT);
+#endif
+
+#if FFT_ACCUM
+    accum_init(_accum_avg, _accum_peak, FFT_OUT_MAX,
+               FFT_ACCUM_AVG_SHIFT, FFT_ACCUM_DECAY_SHIFT);
+#endif
+
+#if ADC_GATE
+    gate_init(ADC_GATE_OPEN, ADC_GATE_CLOSE,
+              ADC_GATE_HOLD, ADC_GATE_HEARTBEAT);
+#endif
+
+#if BENCH
+    dwt_enable_cycle_counter();
+#endif
+
+#if MODE == MODE_FILTER
+    // The FFT output is free as scratch before sampling starts
+    ola_init(_filter_response, _filter_overlap, FILTER_FFT_LEN);
+    ola_set_bandpass(_fft_result, FILTER_LOW, FILTER_HIGH,
+                     ADC_SAMPLE_RATE, FILTER_TAPS);
+#endif
+
+#if MODE == MODE_SDFT
+    sdft_init(_sdft_hist, SDFT_LEN_SHIFT,
+              _sdft_bins, sizeof(_sdft_bins) / sizeof(_sdft_bins[0]),
+              SDFT_ON_LEVEL, SDFT_OFF_LEVEL);
+#endif
+
+#if MODE == MODE_TONES
+    goertzel_init(_tone_freqs, sizeof(_tone_freqs) / sizeof(_tone_freqs[0]),
+                  ADC_SAMPLE_RATE, TONE_LEN_SHIFT);
+#endif
+
+#if MODE == MODE_SCOPE
+    scope_init(SCOPE_TRIGGER_LEVEL,
+               SCOPE_TRIGGER_HYSTERESIS,
+               SCOPE_TRIGGER_EDGE,
+               SCOPE_PRE_TRIGGER,
+               SCOPE_POST_TRIGGER);
+#endif
+
+#if FFT_REF_CHECK
+    fft_ref_check();
+#endif
 
     // Start fetching data
     printf("Starting ADC read\r\n");
@@ -316,10 +1754,31 @@ int main(void)
         /*
         if( i % 100000  == 0 ) {
             // Read ADC
-            printf("Fnord 42 :: %d %d\r\n", _adc_samples[0], _adc_samples[1]);
+            printf("Fnord 42 :: %lu %lu\r\n", _fft_data[0], _fft_data[1]);
         }
         */
 
+        line = usb_serial_rx();
+        if (line) {
+#if MODE == MODE_FFT
+            command_process(line);
+#endif
+        }
+
+#if MODE == MODE_EVENT
+        if (_event_pending) {
+            event_process();
+        }
+
+        // Sleep until the next interrupt; interrupts are masked
+        // so an event can not slip in between check and sleep.
+        cm_disable_interrupts();
+        if (!_event_pending) {
+            __asm__("wfi");
+        }
+        cm_enable_interrupts();
+#endif
+
         i++;
     }
 }
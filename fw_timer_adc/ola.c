@@ -0,0 +1,152 @@
+
+/*
+ * Overlap-add FIR filtering
+ *
+ * Both directions use the block floating point FFT of
+ * ifft.c, the 1/len scaling of the cr4 FFT would cost
+ * log2(len) bits of the spectrum. For real input the
+ * forward DFT is the conjugate of the unscaled inverse.
+ * The exponents of both transforms and the 1/len of the
+ * round trip are applied once, to the filtered samples.
+ *
+ * Input and FIR are real, the spectrum is conjugate
+ * symmetric and the response is only kept for bins
+ * 0 .. len / 2.
+ */
+
+#include <math.h>
+
+#include "ola.h"
+#include "ifft.h"
+
+#define C_REAL(X) ((int16_t)((X) & 0xffff))
+#define C_IMAG(X) ((int16_t)((X) >> 16))
+#define C_PACK(RE, IM) (((uint32_t)(uint16_t)(IM) << 16) | (uint16_t)(RE))
+
+// The response is Q14, a little headroom for the pass band ripple
+#define OLA_FRAC 14
+
+static uint32_t* _ola_response;
+static int16_t*  _ola_overlap;
+static size_t    _ola_len;
+
+
+void ola_init(uint32_t* response, int16_t* overlap, size_t len)
+{
+    _ola_response = response;
+    _ola_overlap = overlap;
+    _ola_len = len;
+
+    // Pass everything until a response is set
+    for (size_t k = 0; k <= len / 2; k++) {
+        response[k] = C_PACK(1 << OLA_FRAC, 0);
+    }
+
+    ola_reset();
+}
+
+
+void ola_reset()
+{
+    for (size_t i = 0; i < _ola_len / 2; i++) {
+        _ola_overlap[i] = 0;
+    }
+}
+
+
+static inline int16_t ola_clip(int32_t v)
+{
+    if (v > INT16_MAX) {
+        return INT16_MAX;
+    }
+    else if (v < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return v;
+}
+
+
+// Multiply by 2^shift, rounded when shifting right
+static inline int32_t ola_scale(int32_t v, int shift)
+{
+    if (shift >= 0) {
+        return v << shift;
+    }
+    return (v + (1 << (-shift - 1))) >> -shift;
+}
+
+
+void ola_set_bandpass(uint32_t* scratch,
+                      uint32_t low,
+                      uint32_t high,
+                      uint32_t rate,
+                      size_t taps)
+{
+    double fl = (double)low / rate;
+    double fh = (double)high / rate;
+
+    // Difference of two low passes, Q14
+    for (size_t i = 0; i < _ola_len; i++) {
+        double h = 0;
+        if (i < taps) {
+            double t = i - (taps - 1) / 2.0;
+            h = t == 0 ? 2 * (fh - fl)
+                       : (sin(2 * M_PI * fh * t) - sin(2 * M_PI * fl * t))
+                         / (M_PI * t);
+            h *= 0.54 - 0.46 * cos(2 * M_PI * i / (taps - 1));
+        }
+        scratch[i] = C_PACK(round(h * (1 << OLA_FRAC)), 0);
+    }
+
+    /*
+     * The inverse FFT without scaling is the DFT with the
+     * opposite sign, the response is its conjugate.
+     */
+    uint8_t shift = ifft_transform(scratch, _ola_len);
+    for (size_t k = 0; k <= _ola_len / 2; k++) {
+        int32_t re = C_REAL(scratch[k]) << shift;
+        int32_t im = C_IMAG(scratch[k]) << shift;
+        _ola_response[k] = C_PACK(ola_clip(re), ola_clip(-im));
+    }
+}
+
+
+void ola_apply(uint32_t* data, uint32_t* spectrum)
+{
+    size_t hop = _ola_len / 2;
+
+    // Zero padded real block
+    for (size_t i = 0; i < _ola_len; i++) {
+        spectrum[i] = i < hop ? (data[i] & 0xffff) : 0;
+    }
+
+    // The round trip is scaled by len
+    int shift = 0;
+    while ((1u << -shift) < _ola_len) {
+        shift--;
+    }
+    shift += ifft_transform(spectrum, _ola_len);
+
+    // Multiply the conjugate, the upper bins with the
+    // conjugate response
+    for (size_t k = 0; k < _ola_len; k++) {
+        uint32_t h = k <= hop ? _ola_response[k]
+                              : _ola_response[_ola_len - k];
+        int32_t hr = C_REAL(h);
+        int32_t hi = k <= hop ? C_IMAG(h) : -C_IMAG(h);
+        int32_t xr = C_REAL(spectrum[k]);
+        int32_t xi = -C_IMAG(spectrum[k]);
+
+        int32_t yr = (xr * hr - xi * hi) >> OLA_FRAC;
+        int32_t yi = (xr * hi + xi * hr) >> OLA_FRAC;
+        spectrum[k] = C_PACK(ola_clip(yr), ola_clip(yi));
+    }
+
+    shift += ifft_transform(spectrum, _ola_len);
+
+    for (size_t i = 0; i < hop; i++) {
+        int32_t y = ola_scale(C_REAL(spectrum[i]), shift) + _ola_overlap[i];
+        data[i] = (uint16_t)ola_clip(y);
+        _ola_overlap[i] = ola_clip(ola_scale(C_REAL(spectrum[i + hop]), shift));
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef _OLA_H_
+#define _OLA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Overlap-add FIR filtering in the frequency domain:
+ *
+ * Blocks of hop = len / 2 samples are zero padded to len,
+ * transformed, multiplied with the response of the FIR
+ * and transformed back. The second half of the result
+ * overlaps the next block and is added to it.
+ *
+ * The FIR may have up to hop + 1 taps. The response
+ * (len / 2 + 1 values) and the overlap (hop values) are
+ * provided by the caller.
+ */
+
+void ola_init(uint32_t* response, int16_t* overlap, size_t len);
+
+// Clear the overlap
+void ola_reset();
+
+/*
+ * Set the response to a Hamming windowed sinc band pass
+ * from low to high Hz with taps taps (odd). The scratch
+ * buffer holds len complex values.
+ */
+void ola_set_bandpass(uint32_t* scratch,
+                      uint32_t low,
+                      uint32_t high,
+                      uint32_t rate,
+                      size_t taps);
+
+/*
+ * Filter a block: data holds hop samples in the real
+ * parts, spectrum len values of work space. The filtered
+ * samples replace the input samples.
+ */
+void ola_apply(uint32_t* data, uint32_t* spectrum);
+
+#endif
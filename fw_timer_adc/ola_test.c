@@ -0,0 +1,149 @@
+
+/*
+ * Host test for ola: Round trip and band pass of the
+ * filter mode configuration, with input scaled like
+ * filter_process does.
+ *
+ * Usage: make host_test
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "ola.h"
+
+#define OLA_TEST_LEN    1024
+#define OLA_TEST_RATE   40000
+#define OLA_TEST_LOW    300
+#define OLA_TEST_HIGH   3400
+#define OLA_TEST_TAPS   255
+#define OLA_TEST_BLOCKS 16
+
+// Tone amplitude: 1500 ADC steps, shifted by 15 - 12 bits
+#define OLA_TEST_AMPLITUDE (1500 << 3)
+
+// Targets
+#define OLA_TEST_ROUND_TRIP_SNR 60.0  // dB
+#define OLA_TEST_PASS_SNR       58.0  // dB, against a double FIR
+#define OLA_TEST_STOP_ATTEN     60.0  // dB at 8 kHz
+
+#define OLA_TEST_HOP (OLA_TEST_LEN / 2)
+
+static uint32_t _response[OLA_TEST_LEN / 2 + 1];
+static int16_t  _overlap[OLA_TEST_HOP];
+static uint32_t _data[OLA_TEST_HOP];
+static uint32_t _spectrum[OLA_TEST_LEN];
+
+static double _in[OLA_TEST_BLOCKS * OLA_TEST_HOP];
+static double _out[OLA_TEST_BLOCKS * OLA_TEST_HOP];
+
+
+/*
+ * Filter a tone of freq Hz, block by block
+ */
+static void ola_test_run(double freq)
+{
+    ola_reset();
+    for (size_t b = 0; b < OLA_TEST_BLOCKS; b++) {
+        for (size_t i = 0; i < OLA_TEST_HOP; i++) {
+            size_t n = b * OLA_TEST_HOP + i;
+            long v = lround(OLA_TEST_AMPLITUDE *
+                            sin(2 * M_PI * freq * n / OLA_TEST_RATE + 0.1));
+            _in[n] = v;
+            _data[i] = (uint16_t)(int16_t)v;
+        }
+        ola_apply(_data, _spectrum);
+        for (size_t i = 0; i < OLA_TEST_HOP; i++) {
+            _out[b * OLA_TEST_HOP + i] = (int16_t)(_data[i] & 0xffff);
+        }
+    }
+}
+
+
+// Same FIR as ola_set_bandpass, in double
+static double ola_test_tap(size_t i)
+{
+    double fl = (double)OLA_TEST_LOW / OLA_TEST_RATE;
+    double fh = (double)OLA_TEST_HIGH / OLA_TEST_RATE;
+    double t = i - (OLA_TEST_TAPS - 1) / 2.0;
+    double h = t == 0 ? 2 * (fh - fl)
+                      : (sin(2 * M_PI * fh * t) - sin(2 * M_PI * fl * t))
+                        / (M_PI * t);
+    return h * (0.54 - 0.46 * cos(2 * M_PI * i / (OLA_TEST_TAPS - 1)));
+}
+
+
+/*
+ * Ratio of the reference power to the power of its
+ * difference to the output in dB, after the first two
+ * blocks. Without taps the reference is the input.
+ */
+static double ola_test_snr(int taps)
+{
+    double signal = 0;
+    double noise = 0;
+
+    for (size_t n = 2 * OLA_TEST_HOP; n < OLA_TEST_BLOCKS * OLA_TEST_HOP; n++) {
+        double ref = _in[n];
+        if (taps) {
+            ref = 0;
+            for (size_t i = 0; i < OLA_TEST_TAPS; i++) {
+                ref += ola_test_tap(i) * _in[n - i];
+            }
+        }
+        signal += ref * ref;
+        noise += (_out[n] - ref) * (_out[n] - ref);
+    }
+
+    return 10 * log10(signal / noise);
+}
+
+
+// Ratio of input to output power in dB, after two blocks
+static double ola_test_attenuation()
+{
+    double in = 0;
+    double out = 0;
+
+    for (size_t n = 2 * OLA_TEST_HOP; n < OLA_TEST_BLOCKS * OLA_TEST_HOP; n++) {
+        in += _in[n] * _in[n];
+        out += _out[n] * _out[n];
+    }
+
+    return 10 * log10(in / out);
+}
+
+
+static int ola_test_check(const char* name, double db, double target)
+{
+    int ok = db >= target;
+    printf("ola %-22s %6.1f dB (>= %.0f) %s\n",
+           name, db, target, ok ? "ok" : "FAIL");
+    return !ok;
+}
+
+
+int main()
+{
+    int failed = 0;
+
+    ola_init(_response, _overlap, OLA_TEST_LEN);
+
+    ola_test_run(1000);
+    failed |= ola_test_check("round trip snr",
+                             ola_test_snr(0), OLA_TEST_ROUND_TRIP_SNR);
+
+    ola_set_bandpass(_spectrum, OLA_TEST_LOW, OLA_TEST_HIGH,
+                     OLA_TEST_RATE, OLA_TEST_TAPS);
+
+    ola_test_run(1000);
+    failed |= ola_test_check("pass band 1 kHz snr",
+                             ola_test_snr(1), OLA_TEST_PASS_SNR);
+
+    ola_test_run(8000);
+    failed |= ola_test_check("stop band 8 kHz",
+                             ola_test_attenuation(), OLA_TEST_STOP_ATTEN);
+
+    return failed;
+}
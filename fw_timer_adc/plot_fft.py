@@ -5,6 +5,10 @@ s = serial.Serial("/dev/ttyACM0")
 
 buckets = list(0 for _ in range(512))
 
+# Bin value per character: 160 for linear magnitudes,
+# 2 for the firmware's 8 bit dB output (1/2 dB steps)
+SCALE = 2
+
 def downsample(bin_size):
     avg = 0
     res = []
@@ -12,7 +16,8 @@ def downsample(bin_size):
     for i, val in enumerate(buckets):
         avg += val / bin_size
         if (i+1) % bin_size == 0:
-            res += [round(avg / 160)]
+            res += [round(avg / SCALE)]
+            avg = 0
 
     return res
 
@@ -27,10 +32,16 @@ def draw_fft():
 
 
 for line in s:
-    tokens = str(line, "utf8").strip().split(" ")
+    line = str(line, "utf8").strip()
+    if line.startswith("#"):
+        continue # Frame info
+
+    tokens = line.split(" ")
     b = int(tokens[0])
     val = int(tokens[1])
 
+    if b >= len(buckets):
+        buckets += [0] * (b + 1 - len(buckets))
     buckets[b] = val
 
     if b == 0:
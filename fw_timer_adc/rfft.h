@@ -0,0 +1,29 @@
+#ifndef _RFFT_H_
+#define _RFFT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Real valued FFT: 2N real samples are packed into N
+ * complex values z[n] = x[2n] + j x[2n+1], transformed
+ * with the N point complex FFT and split into the
+ * spectrum of x.
+ */
+
+// Maximum number of complex points
+#define RFFT_LEN 1024
+
+// Q15 twiddles for k = 0 .. N/2, generated by gen_rfft.py
+extern const int16_t rfft_cos[RFFT_LEN / 2 + 1];
+extern const int16_t rfft_sin[RFFT_LEN / 2 + 1];
+
+/*
+ * Split the complex FFT of the packed sequence into
+ * bins 0 .. N-1 of the real spectrum, in place.
+ * len is N, a power of 2 up to RFFT_LEN.
+ * The result is scaled by 1/2.
+ */
+void rfft_split(uint32_t* values, size_t len);
+
+#endif
@@ -0,0 +1,153 @@
+
+/*
+ * Oscilloscope style capture with pre- and post-trigger
+ * window on a ring buffer.
+ */
+
+#include "scope.h"
+
+#define SCOPE_BUF_MASK (SCOPE_BUF_LEN - 1)
+
+#define SCOPE_STATE_FILL      0 // Waiting for pre-trigger samples
+#define SCOPE_STATE_ARMED     1
+#define SCOPE_STATE_TRIGGERED 2
+#define SCOPE_STATE_DONE      3
+
+static uint16_t _scope_buf[SCOPE_BUF_LEN];
+
+static uint16_t _scope_level;
+static uint16_t _scope_hysteresis;
+static uint8_t  _scope_edge;
+static size_t   _scope_pre;
+static size_t   _scope_post;
+
+static uint8_t  _scope_state;
+static uint8_t  _scope_primed; // Signal was on the other side of the level
+static size_t   _scope_pos;
+static size_t   _scope_count;  // Samples since arm / trigger
+static size_t   _scope_trigger_pos;
+static size_t   _scope_unused;  // Samples fed after the window
+
+
+/*
+ * Configure trigger level and edge, and the number
+ * of samples to keep before and after the trigger.
+ */
+void scope_init(uint16_t level, uint16_t hysteresis, uint8_t edge,
+                size_t pre, size_t post)
+{
+    if (pre + post > SCOPE_BUF_LEN) {
+        post = SCOPE_BUF_LEN - pre;
+    }
+
+    _scope_level = level;
+    _scope_hysteresis = hysteresis;
+    _scope_edge = edge;
+    _scope_pre = pre;
+    _scope_post = post;
+
+    scope_arm();
+}
+
+/*
+ * Start waiting for the next trigger
+ */
+void scope_arm()
+{
+    _scope_state = SCOPE_STATE_FILL;
+    _scope_primed = 0;
+    _scope_count = 0;
+}
+
+
+/*
+ * Check for a trigger condition: The signal has to
+ * leave the hysteresis band on one side of the level
+ * before crossing it from there.
+ */
+static inline uint8_t scope_trigger(uint16_t v)
+{
+    if (_scope_edge == SCOPE_EDGE_RISING) {
+        if (v + _scope_hysteresis < _scope_level) {
+            _scope_primed = 1;
+        } else if (_scope_primed && v >= _scope_level) {
+            return 1;
+        }
+    } else {
+        if (v > _scope_level + _scope_hysteresis) {
+            _scope_primed = 1;
+        } else if (_scope_primed && v <= _scope_level) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+uint8_t scope_feed(const uint16_t* samples, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (_scope_state == SCOPE_STATE_DONE) {
+            _scope_unused = len - i;
+            return 1;
+        }
+
+        _scope_buf[_scope_pos] = samples[i];
+
+        switch (_scope_state) {
+            case SCOPE_STATE_FILL:
+                // Make sure the pre-trigger part is valid
+                _scope_count++;
+                if (_scope_count <= _scope_pre) {
+                    break;
+                }
+                _scope_state = SCOPE_STATE_ARMED;
+                // fall through
+
+            case SCOPE_STATE_ARMED:
+                if (scope_trigger(samples[i])) {
+                    _scope_state = SCOPE_STATE_TRIGGERED;
+                    _scope_trigger_pos = _scope_pos;
+                    _scope_count = 1;
+                }
+                break;
+
+            case SCOPE_STATE_TRIGGERED:
+                _scope_count++;
+                break;
+        }
+
+        _scope_pos = (_scope_pos + 1) & SCOPE_BUF_MASK;
+
+        if (_scope_state == SCOPE_STATE_TRIGGERED &&
+            _scope_count >= _scope_post) {
+            _scope_state = SCOPE_STATE_DONE;
+            _scope_unused = len - i - 1;
+        }
+    }
+
+    return _scope_state == SCOPE_STATE_DONE;
+}
+
+
+size_t scope_window_len()
+{
+    return _scope_pre + _scope_post;
+}
+
+
+size_t scope_unused()
+{
+    return _scope_unused;
+}
+
+/*
+ * Get sample i of the captured window, the trigger
+ * is at i = pre.
+ */
+uint16_t scope_window_sample(size_t i)
+{
+    size_t start = _scope_trigger_pos - _scope_pre;
+    return _scope_buf[(start + i) & SCOPE_BUF_MASK];
+}
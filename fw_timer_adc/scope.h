@@ -0,0 +1,33 @@
+#ifndef _SCOPE_H_
+#define _SCOPE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Oscilloscope style capture: Samples are continuously
+ * written to a ring buffer, when the trigger fires the
+ * window around it is frozen.
+ */
+
+// Ring buffer length, must be a power of 2
+#define SCOPE_BUF_LEN 1024
+
+#define SCOPE_EDGE_RISING  0
+#define SCOPE_EDGE_FALLING 1
+
+void scope_init(uint16_t level, uint16_t hysteresis, uint8_t edge,
+                size_t pre, size_t post);
+
+void scope_arm();
+
+// Returns 1 when a window was captured
+uint8_t scope_feed(const uint16_t* samples, size_t len);
+
+size_t   scope_window_len();
+uint16_t scope_window_sample(size_t i);
+
+// Samples of the last block fed after the window was complete
+size_t   scope_unused();
+
+#endif
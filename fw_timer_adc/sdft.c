@@ -0,0 +1,182 @@
+
+/*
+ * Fixed point sliding DFT
+ *
+ *   X[n] = r W (X[n-1] + x[n] - r^N x[n-N]),  W = e^(j 2 pi k / N)
+ *
+ * Rounding errors would accumulate forever on the unit
+ * circle, the damping r < 1 makes them decay instead.
+ * The r^N term cancels the damped contribution of the
+ * sample leaving the window exactly.
+ *
+ * The damping tapers the window, a tone is seen with the
+ * gain (1 - r^N) / (N (1 - r)), which is corrected for
+ * levels and amplitudes.
+ */
+
+#include <math.h>
+
+#include "sdft.h"
+#include "sqrt.h"
+
+// Damping r = 1 - 2^-SDFT_DAMP_SHIFT
+#define SDFT_DAMP_SHIFT 12
+
+// Twiddles are Q30, the state has 8 fractional bits
+#define SDFT_TWIDDLE_FRAC 30
+#define SDFT_STATE_FRAC   8
+
+// r^N is Q15
+#define SDFT_DECAY_FRAC 15
+
+typedef struct {
+    int32_t re;
+    int32_t im;
+    int32_t w_re;   // r W
+    int32_t w_im;
+    uint8_t on;
+    size_t  switch_pos;
+} sdft_bin_t;
+
+static sdft_bin_t _sdft_bins[SDFT_MAX];
+static size_t     _sdft_count;
+
+static int16_t* _sdft_hist;
+static size_t   _sdft_pos;
+static uint8_t  _sdft_shift;
+static int32_t  _sdft_decay;  // r^N
+static int32_t  _sdft_gain;   // Q15
+
+// Squared levels in the scale of the state
+static int64_t _sdft_on_power;
+static int64_t _sdft_off_power;
+
+
+static int64_t sdft_level_power(uint32_t level)
+{
+    // Amplitude A gives |X| = gain A N / 2
+    int64_t x = (((int64_t)level * _sdft_gain) >> SDFT_DECAY_FRAC)
+                << (SDFT_STATE_FRAC + _sdft_shift - 1);
+    return x * x;
+}
+
+
+void sdft_init(int16_t* hist,
+               uint8_t len_shift,
+               const uint16_t* bins,
+               size_t count,
+               uint32_t on_level,
+               uint32_t off_level)
+{
+    if (count > SDFT_MAX) {
+        count = SDFT_MAX;
+    }
+
+    size_t len = 1 << len_shift;
+    double r = 1.0 - 1.0 / (1 << SDFT_DAMP_SHIFT);
+
+    for (size_t i = 0; i < count; i++) {
+        double phi = 2 * M_PI * bins[i] / len;
+        _sdft_bins[i].w_re = round(r * cos(phi) * (1 << SDFT_TWIDDLE_FRAC));
+        _sdft_bins[i].w_im = round(r * sin(phi) * (1 << SDFT_TWIDDLE_FRAC));
+    }
+
+    _sdft_count = count;
+    _sdft_hist = hist;
+    _sdft_shift = len_shift;
+    _sdft_decay = round(pow(r, len) * (1 << SDFT_DECAY_FRAC));
+    _sdft_gain = round((1 - pow(r, len)) / (len * (1 - r))
+                       * (1 << SDFT_DECAY_FRAC));
+
+    _sdft_on_power = sdft_level_power(on_level);
+    _sdft_off_power = sdft_level_power(off_level);
+
+    sdft_reset();
+}
+
+
+void sdft_reset()
+{
+    for (size_t i = 0; i < (1u << _sdft_shift); i++) {
+        _sdft_hist[i] = 0;
+    }
+    _sdft_pos = 0;
+
+    for (size_t i = 0; i < _sdft_count; i++) {
+        _sdft_bins[i].re = 0;
+        _sdft_bins[i].im = 0;
+        _sdft_bins[i].on = 0;
+        _sdft_bins[i].switch_pos = 0;
+    }
+}
+
+
+static inline int64_t sdft_power(const sdft_bin_t* bin)
+{
+    return (int64_t)bin->re * bin->re + (int64_t)bin->im * bin->im;
+}
+
+
+uint32_t sdft_feed(const uint16_t* samples, size_t n, dc_filter_t* dc)
+{
+    uint32_t switched = 0;
+    size_t mask = (1u << _sdft_shift) - 1;
+
+    for (size_t k = 0; k < n; k++) {
+        int32_t x = dc_filter_step(dc, samples[k]);
+
+        // New sample in, the oldest one out
+        int32_t d = (x << SDFT_STATE_FRAC) -
+                    ((_sdft_decay * _sdft_hist[_sdft_pos])
+                     >> (SDFT_DECAY_FRAC - SDFT_STATE_FRAC));
+        _sdft_hist[_sdft_pos] = x;
+        _sdft_pos = (_sdft_pos + 1) & mask;
+
+        for (size_t i = 0; i < _sdft_count; i++) {
+            sdft_bin_t* bin = &_sdft_bins[i];
+            int64_t a = bin->re + d;
+            int64_t b = bin->im;
+
+            bin->re = (a * bin->w_re - b * bin->w_im) >> SDFT_TWIDDLE_FRAC;
+            bin->im = (a * bin->w_im + b * bin->w_re) >> SDFT_TWIDDLE_FRAC;
+
+            int64_t power = sdft_power(bin);
+            if (bin->on ? power < _sdft_off_power
+                        : power >= _sdft_on_power) {
+                bin->on = !bin->on;
+                bin->switch_pos = k;
+                switched |= 1u << i;
+            }
+        }
+    }
+
+    return switched;
+}
+
+
+uint8_t sdft_on(size_t i)
+{
+    return _sdft_bins[i].on;
+}
+
+
+size_t sdft_switch_pos(size_t i)
+{
+    return _sdft_bins[i].switch_pos;
+}
+
+
+uint32_t sdft_amplitude(size_t i)
+{
+    // |X| 2 / N, the squared amplitude fits 32 bit
+    int64_t power = sdft_power(&_sdft_bins[i]);
+    uint32_t amp = fast_sqrt_newton(
+        power >> (2 * (SDFT_STATE_FRAC + _sdft_shift - 1)));
+    return (amp << SDFT_DECAY_FRAC) / _sdft_gain;
+}
+
+
+size_t sdft_count()
+{
+    return _sdft_count;
+}
@@ -0,0 +1,50 @@
+#ifndef _SDFT_H_
+#define _SDFT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "dc_filter.h"
+
+/*
+ * Sliding DFT: A few bins of a 1 << len_shift point DFT
+ * are updated with every sample, so a tone is seen with
+ * the latency of a sample instead of a frame.
+ *
+ * Every bin has an on and off level (amplitude in ADC
+ * steps) with hysteresis in between.
+ *
+ * The history of len samples is provided by the caller.
+ */
+
+#define SDFT_MAX 8
+
+void sdft_init(int16_t* hist,
+               uint8_t len_shift,
+               const uint16_t* bins,
+               size_t count,
+               uint32_t on_level,
+               uint32_t off_level);
+
+// Clear the history and all bins
+void sdft_reset();
+
+/*
+ * Feed raw samples, the offset is removed by dc.
+ * Returns a mask of the bins which were switched
+ * on or off.
+ */
+uint32_t sdft_feed(const uint16_t* samples, size_t n, dc_filter_t* dc);
+
+// Current state of bin i
+uint8_t sdft_on(size_t i);
+
+// Sample within the last feed where bin i switched
+size_t sdft_switch_pos(size_t i);
+
+// Amplitude of bin i in ADC steps
+uint32_t sdft_amplitude(size_t i);
+
+size_t sdft_count();
+
+#endif
@@ -40,3 +40,62 @@ uint32_t fast_sqrt(uint32_t x)
 
 	return(res);
 }
+
+
+/*
+ * Square root with a table seed and one newton step.
+ *
+ * The argument is normalized with CLZ to 8 significant bits,
+ * the table gives sqrt to about 8 bits, newton doubles that.
+ * A final correction makes the result exact, same as above:
+ *
+ *     res^2 <= x < (res+1)^2
+ */
+
+// 16 * sqrt(m + 1/2) for m = 64 .. 255, centered on the truncated bits
+static const uint8_t _sqrt_seed[192] = {
+    128, 129, 130, 131, 132, 133, 134, 135, 136, 137, 138, 139, 140, 141, 142, 143,
+    144, 144, 145, 146, 147, 148, 149, 150, 151, 151, 152, 153, 154, 155, 156, 156,
+    157, 158, 159, 160, 160, 161, 162, 163, 164, 164, 165, 166, 167, 167, 168, 169,
+    170, 170, 171, 172, 173, 173, 174, 175, 176, 176, 177, 178, 179, 179, 180, 181,
+    181, 182, 183, 183, 184, 185, 186, 186, 187, 188, 188, 189, 190, 190, 191, 192,
+    192, 193, 194, 194, 195, 196, 196, 197, 198, 198, 199, 200, 200, 201, 201, 202,
+    203, 203, 204, 205, 205, 206, 206, 207, 208, 208, 209, 210, 210, 211, 211, 212,
+    213, 213, 214, 214, 215, 216, 216, 217, 217, 218, 219, 219, 220, 220, 221, 221,
+    222, 223, 223, 224, 224, 225, 225, 226, 227, 227, 228, 228, 229, 229, 230, 230,
+    231, 232, 232, 233, 233, 234, 234, 235, 235, 236, 237, 237, 238, 238, 239, 239,
+    240, 240, 241, 241, 242, 242, 243, 243, 244, 244, 245, 246, 246, 247, 247, 248,
+    248, 249, 249, 250, 250, 251, 251, 252, 252, 253, 253, 254, 254, 255, 255, 255,
+};
+
+uint32_t fast_sqrt_newton(uint32_t x)
+{
+    if (x == 0) {
+        return 0;
+    }
+
+    // Even shift, so m = x >> shift is 64 .. 255
+    int32_t shift = ((31 - __builtin_clz(x)) & ~1) - 6;
+
+    uint32_t res;
+    if (shift >= 0) {
+        res = ((uint32_t)_sqrt_seed[(x >> shift) - 64] << (shift / 2)) >> 4;
+    }
+    else {
+        res = _sqrt_seed[(x << -shift) - 64] >> (4 - shift / 2);
+    }
+
+    res = (res + x / res) / 2;
+    if (res > 0xffff) {
+        res = 0xffff;
+    }
+
+    if (res * res > x) {
+        res--;
+    }
+    else if (x - res * res > 2 * res) {
+        res++;
+    }
+
+    return res;
+}
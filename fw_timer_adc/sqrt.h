@@ -1,7 +1,10 @@
 #ifndef _SQRT_H_
 #define _SQRT_H_
 
+#include <stdint.h>
+
 uint32_t fast_sqrt(uint32_t x);
+uint32_t fast_sqrt_newton(uint32_t x);
 
 #endif
 
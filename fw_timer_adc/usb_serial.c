@@ -37,6 +37,8 @@ static char    _rx_buf[RX_BUF_LEN];
 static size_t  _rx_tmp_len;
 static uint8_t _rx_buf_ready;
 
+static uint32_t _tx_dropped; // Packets not sent
+
 static usbd_device* __USBDEV;
 
 static const struct usb_device_descriptor device_descriptor = {
@@ -300,6 +302,7 @@ size_t usb_serial_tx(const char *data, size_t len)
 
         size_t res = usbd_ep_write_packet(__USBDEV, 0x82, tx_buf, tx_len);
         if (res == 0) {
+            _tx_dropped++;
             return tx_total; // Something failed
         }
 
@@ -309,6 +312,11 @@ size_t usb_serial_tx(const char *data, size_t len)
     return tx_total;
 }
 
+uint32_t usb_serial_tx_dropped()
+{
+    return _tx_dropped;
+}
+
 /*
  * Initialize GPIO for D+ and status LED
  */
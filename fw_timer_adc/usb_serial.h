@@ -6,6 +6,7 @@
 usbd_device* usb_serial_init();
 const char*  usb_serial_rx();
 size_t       usb_serial_tx(const char*, size_t);
+uint32_t     usb_serial_tx_dropped();
 
 
 #endif
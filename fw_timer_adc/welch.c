@@ -0,0 +1,56 @@
+
+/*
+ * Welch averaging of power spectra
+ */
+
+#include <string.h>
+
+#include "welch.h"
+
+static uint32_t* _welch_acc;
+static size_t    _welch_acc_len;
+static uint8_t   _welch_shift;
+static uint32_t  _welch_count;
+
+
+void welch_init(uint32_t* acc, size_t len, uint8_t frames_shift)
+{
+    _welch_acc = acc;
+    _welch_acc_len = len;
+    _welch_shift = frames_shift;
+
+    welch_reset();
+}
+
+
+void welch_reset()
+{
+    memset(_welch_acc, 0, _welch_acc_len * sizeof(uint32_t));
+    _welch_count = 0;
+}
+
+
+uint8_t welch_accumulate(uint32_t* values, size_t len)
+{
+    if (len > _welch_acc_len) {
+        len = _welch_acc_len;
+    }
+
+    // Divide each frame before summing up, full scale powers
+    // of a few frames would overflow 32 bit. Rounding keeps
+    // the average unbiased.
+    uint32_t half = _welch_shift ? 1u << (_welch_shift - 1) : 0;
+    for (size_t i = 0; i < len; i++) {
+        _welch_acc[i] += (values[i] >> _welch_shift) +
+                         ((values[i] & half) != 0);
+    }
+
+    if (++_welch_count < (1u << _welch_shift)) {
+        return 0;
+    }
+
+    memcpy(values, _welch_acc, len * sizeof(uint32_t));
+
+    welch_reset();
+    return 1;
+}
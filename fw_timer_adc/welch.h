@@ -0,0 +1,27 @@
+#ifndef _WELCH_H_
+#define _WELCH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Welch averaging: The power spectra of 1 << frames_shift
+ * overlapping frames are summed up and averaged.
+ *
+ * The accumulator acc is provided by the caller and holds
+ * one value per bin (or band). Frames are scaled down as
+ * they are added, so the sum fits 32 bit.
+ */
+
+void welch_init(uint32_t* acc, size_t len, uint8_t frames_shift);
+
+// Drop a partial average, e.g. after a length change
+void welch_reset();
+
+/*
+ * Add a power spectrum. When enough frames are summed up,
+ * the average replaces values and 1 is returned.
+ */
+uint8_t welch_accumulate(uint32_t* values, size_t len);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef _WINDOW_H_
+#define _WINDOW_H_
+
+#include <stdint.h>
+
+/*
+ * Window tables, generated at build time by gen_windows.py
+ *
+ * Each table holds the first half of a periodic window of
+ * WINDOW_LEN samples, including the center weight, in Q15.
+ * For a frame of WINDOW_LEN / step samples use every
+ * step-th weight, the second half is mirrored:
+ *
+ *   w[i] = table[i * step]            i <= len / 2
+ *   w[i] = table[(len - i) * step]    i >  len / 2
+ */
+
+#define WINDOW_LEN 2048
+
+#define WINDOW_HANN            0
+#define WINDOW_HAMMING         1
+#define WINDOW_BLACKMAN_HARRIS 2
+#define WINDOW_FLATTOP         3
+
+#define WINDOW_COUNT 4
+
+extern const int16_t* const window_tables[WINDOW_COUNT];
+extern const char* const window_names[WINDOW_COUNT];
+
+#endif